@@ -69,6 +69,16 @@ static bool has_infile = false;
 static cmd_function quit_helpers[MAXQUIT];
 static int quit_helper_cnt = 0;
 
+/* Maximum number of watched file descriptors */
+
+#define MAXWATCH 10
+/* File descriptors watched by cmd_select() along with command input */
+static struct {
+    int fd;
+    watch_function ready;
+} watches[MAXWATCH];
+static int watch_cnt = 0;
+
 static void init_in();
 
 static bool push_file(char *fname);
@@ -222,6 +232,29 @@ void add_quit_helper(cmd_function qf)
         report_event(MSG_FATAL, "Exceeded limit on quit helpers");
 }
 
+/* Have cmd_select() call ready(fd) whenever fd is readable */
+bool add_watch(int fd, watch_function ready)
+{
+    if (watch_cnt == MAXWATCH) {
+        report_event(MSG_ERROR, "Exceeded limit on watched file descriptors");
+        return false;
+    }
+    watches[watch_cnt].fd = fd;
+    watches[watch_cnt++].ready = ready;
+    return true;
+}
+
+/* Stop watching fd */
+void remove_watch(int fd)
+{
+    for (int i = 0; i < watch_cnt; i++) {
+        if (watches[i].fd == fd) {
+            watches[i] = watches[--watch_cnt];
+            return;
+        }
+    }
+}
+
 /* Turn echoing on/off */
 void set_echo(bool on)
 {
@@ -571,6 +604,12 @@ int cmd_select(int nfds,
             nfds = infd + 1;
         if (listenfd >= nfds)
             nfds = listenfd + 1;
+
+        for (int i = 0; i < watch_cnt; i++) {
+            FD_SET(watches[i].fd, readfds);
+            if (watches[i].fd >= nfds)
+                nfds = watches[i].fd + 1;
+        }
     }
     if (nfds == 0)
         return 0;
@@ -579,6 +618,20 @@ int cmd_select(int nfds,
     if (result <= 0)
         return result;
 
+    /* Serve watched file descriptors first, as commands may remove them */
+    for (int i = 0; !block_flag && readfds && i < watch_cnt; i++) {
+        int fd = watches[i].fd;
+        if (!FD_ISSET(fd, readfds))
+            continue;
+        FD_CLR(fd, readfds);
+        result--;
+        if (!watches[i].ready(fd)) {
+            /* The last one took its place */
+            remove_watch(fd);
+            i--;
+        }
+    }
+
     infd = buf_stack->fd;
     if (readfds && FD_ISSET(infd, readfds)) {
         /* Commandline input available */
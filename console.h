@@ -57,6 +57,23 @@ bool get_int(char *vname, int *loc);
 /* Add function to be executed as part of program exit */
 void add_quit_helper(cmd_function qf);
 
+/*
+ * Function called by cmd_select() when a watched file descriptor is readable.
+ * Return false to stop watching it.
+ */
+typedef bool (*watch_function)(int fd);
+
+/*
+ * Have cmd_select() also wait for fd to be readable, and then call ready(fd).
+ * Only served while commands are read through cmd_select(), i.e. not while
+ * linenoise waits for a line typed in.
+ * Return false if too many file descriptors are watched already.
+ */
+bool add_watch(int fd, watch_function ready);
+
+/* Stop watching fd */
+void remove_watch(int fd);
+
 /* Turn echoing on/off */
 void set_echo(bool on);
 
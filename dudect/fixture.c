@@ -190,3 +190,13 @@ bool is_remove_tail_const(void)
 {
     return TEST_CONST("remove_tail", 3);
 }
+
+bool is_size_const(void)
+{
+    return TEST_CONST("size", 4);
+}
+
+bool is_delete_mid_const(void)
+{
+    return TEST_CONST("delete_mid", 5);
+}
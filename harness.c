@@ -1,5 +1,6 @@
 /* Test support code */
 
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -41,13 +42,26 @@ typedef struct BELE {
     /* Also place magic number at tail of every block */
 } block_ele_t;
 
+/* Lock of the list of allocated blocks and of the counters below, taken in
+ * threaded mode only
+ */
+static pthread_mutex_t allocated_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Signal mask of the thread holding allocated_lock, from before it blocked
+ * SIGALRM
+ */
+static sigset_t allocated_mask;
+
 static block_ele_t *allocated = NULL;
 static size_t allocated_count = 0;
+/* Bytes in allocated blocks, and the most of them since last asked */
+static size_t allocated_bytes = 0, peak_bytes = 0;
 
 /* Percent probability of malloc failure */
 int fail_probability = 0;
 
 static bool cautious_mode = true;
+static bool threaded_mode = false;
 static bool noallocate_mode = false;
 static bool error_occurred = false;
 static char *error_message = "";
@@ -65,6 +79,33 @@ static bool time_limited = false;
  * Internal functions
  */
 
+/*
+ * Take allocated_lock in threaded mode. SIGALRM stays blocked until
+ * unlock_allocated(), so that the time limit cannot jump out of
+ * trigger_exception() with the lock held.
+ */
+static void lock_allocated()
+{
+    sigset_t alarm, old;
+    if (!threaded_mode)
+        return;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm, &old);
+    pthread_mutex_lock(&allocated_lock);
+    allocated_mask = old;
+}
+
+static void unlock_allocated()
+{
+    sigset_t old;
+    if (!threaded_mode)
+        return;
+    old = allocated_mask;
+    pthread_mutex_unlock(&allocated_lock);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
 /* Should this allocation fail? */
 static bool fail_allocation()
 {
@@ -148,6 +189,7 @@ void *test_malloc(size_t size)
     *find_footer(new_block) = MAGICFOOTER;
     void *p = (void *) &new_block->payload;
     memset(p, FILLCHAR, size);
+    lock_allocated();
     // cppcheck-suppress nullPointerRedundantCheck
     new_block->next = allocated;
     // cppcheck-suppress nullPointerRedundantCheck
@@ -157,6 +199,10 @@ void *test_malloc(size_t size)
         allocated->prev = new_block;
     allocated = new_block;
     allocated_count++;
+    allocated_bytes += size;
+    if (allocated_bytes > peak_bytes)
+        peak_bytes = allocated_bytes;
+    unlock_allocated();
 
     return p;
 }
@@ -183,6 +229,7 @@ void test_free(void *p)
     if (!p)
         return;
 
+    lock_allocated();
     block_ele_t *b = find_header(p);
     size_t footer = *find_footer(b);
     if (footer != MAGICFOOTER) {
@@ -206,8 +253,10 @@ void test_free(void *p)
     if (bn)
         bn->prev = bp;
 
-    free(b);
+    allocated_bytes -= b->payload_size;
     allocated_count--;
+    unlock_allocated();
+    free(b);
 }
 
 // cppcheck-suppress unusedFunction
@@ -226,6 +275,18 @@ size_t allocation_check()
     return allocated_count;
 }
 
+size_t allocation_bytes()
+{
+    return allocated_bytes;
+}
+
+size_t allocation_peak()
+{
+    size_t peak = peak_bytes;
+    peak_bytes = allocated_bytes;
+    return peak;
+}
+
 /*
  * Implementation of functions for testing
  */
@@ -239,6 +300,16 @@ void set_cautious_mode(bool cautious)
     cautious_mode = cautious;
 }
 
+/*
+ * Set/unset threaded mode.
+ * In this mode, blocks may be allocated and freed from several threads at
+ * once.
+ */
+void set_threaded_mode(bool threaded)
+{
+    threaded_mode = threaded;
+}
+
 /*
  * Set/unset restricted allocation mode.
  * In this mode, calls to malloc and free are disallowed.
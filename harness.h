@@ -17,11 +17,27 @@ void test_free(void *p);
 char *test_strdup(const char *s);
 /* FIXME: provide test_realloc as well */
 
+/*
+ * Set/unset threaded mode.
+ * In this mode, blocks may be allocated and freed from several threads at
+ * once.
+ */
+void set_threaded_mode(bool threaded);
+
 #ifdef INTERNAL
 
 /* Report number of allocated blocks */
 size_t allocation_check();
 
+/* Report number of bytes in allocated blocks */
+size_t allocation_bytes();
+
+/*
+ * Report the largest number of bytes allocated at a time since the previous
+ * call, and track the peak from the current usage on.
+ */
+size_t allocation_peak();
+
 /* Probability of malloc failing, expressed as percent */
 extern int fail_probability;
 
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "intern.h"
+
+/* Initial number of buckets */
+#define INTERN_MIN_BUCKETS 64
+
+struct intern_entry {
+    struct intern_entry *next; /* Next entry of the same bucket */
+    uint32_t hash;
+    size_t refs; /* Number of references to the string */
+    size_t size; /* Size of the string, null terminator included */
+    char str[];
+};
+
+/*
+ * Hash string s of `size` bytes.
+ */
+static uint32_t intern_hash(const char *s, size_t size);
+
+/*
+ * Double the buckets of table, keeping the old ones if could not allocate.
+ */
+static void intern_grow(intern_t *table);
+
+/*
+ * Take a reference to the interned copy of string s of `size` bytes, null
+ * terminator included, interning it if it is not yet.
+ * Return NULL if could not allocate space.
+ */
+char *intern_get(intern_t *table, const char *s, size_t size)
+{
+    uint32_t hash = intern_hash(s, size);
+    struct intern_entry *e;
+    if (!table->buckets) {
+        table->buckets =
+            malloc(INTERN_MIN_BUCKETS * sizeof(struct intern_entry *));
+        if (!table->buckets)
+            return NULL;
+        memset(table->buckets, 0,
+               INTERN_MIN_BUCKETS * sizeof(struct intern_entry *));
+        table->mask = INTERN_MIN_BUCKETS - 1;
+        table->stats.bytes += INTERN_MIN_BUCKETS * sizeof(*table->buckets);
+    }
+    for (e = table->buckets[hash & table->mask]; e; e = e->next) {
+        if (e->hash == hash && e->size == size && !memcmp(e->str, s, size))
+            break;
+    }
+    if (!e) {
+        e = malloc(sizeof(struct intern_entry) + size);
+        if (!e)
+            return NULL;
+        e->hash = hash;
+        e->refs = 0;
+        e->size = size;
+        memcpy(e->str, s, size);
+        e->next = table->buckets[hash & table->mask];
+        table->buckets[hash & table->mask] = e;
+        table->stats.strings++;
+        table->stats.bytes += sizeof(struct intern_entry) + size;
+        if (table->stats.strings > table->mask)
+            intern_grow(table);
+    }
+    e->refs++;
+    table->stats.refs++;
+    table->stats.copied += size;
+    return e->str;
+}
+
+/*
+ * Drop a reference to interned string s, freeing it with the last one.
+ * Return false, with no effect, if s is not a string interned in table.
+ */
+bool intern_put(intern_t *table, const char *s)
+{
+    struct intern_entry **p, *e;
+    size_t size;
+    if (!table->stats.strings)
+        return false;
+    size = strlen(s) + 1;
+    // Only the entry holding s itself counts, not an equal string elsewhere
+    p = &table->buckets[intern_hash(s, size) & table->mask];
+    for (; *p && (*p)->str != s; p = &(*p)->next)
+        ;
+    e = *p;
+    if (!e)
+        return false;
+    table->stats.refs--;
+    table->stats.copied -= size;
+    if (--e->refs)
+        return true;
+    *p = e->next;
+    table->stats.strings--;
+    table->stats.bytes -= sizeof(struct intern_entry) + size;
+    free(e);
+    return true;
+}
+
+/*
+ * Free the buckets of table if it holds no string.
+ */
+void intern_trim(intern_t *table)
+{
+    if (table->stats.strings)
+        return;
+    free(table->buckets);
+    table->buckets = NULL;
+    table->mask = 0;
+    table->stats.bytes = 0;
+}
+
+/*
+ * Hash string s of `size` bytes.
+ */
+static uint32_t intern_hash(const char *s, size_t size)
+{
+    // 32-bit FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (unsigned char) s[i]) * 16777619u;
+    return hash;
+}
+
+/*
+ * Double the buckets of table, keeping the old ones if could not allocate.
+ */
+static void intern_grow(intern_t *table)
+{
+    size_t cnt = (table->mask + 1) * 2;
+    struct intern_entry **buckets = malloc(cnt * sizeof(*buckets));
+    if (!buckets)
+        return;
+    memset(buckets, 0, cnt * sizeof(*buckets));
+    for (size_t i = 0; i <= table->mask; i++) {
+        struct intern_entry *e, *next;
+        for (e = table->buckets[i]; e; e = next) {
+            next = e->next;
+            e->next = buckets[e->hash & (cnt - 1)];
+            buckets[e->hash & (cnt - 1)] = e;
+        }
+    }
+    free(table->buckets);
+    table->stats.bytes += (cnt - table->mask - 1) * sizeof(*buckets);
+    table->buckets = buckets;
+    table->mask = cnt - 1;
+}
@@ -0,0 +1,56 @@
+#ifndef LAB0_INTERN_H
+#define LAB0_INTERN_H
+
+/*
+ * Table of interned strings.
+ *
+ * Each distinct string is stored once, along with the number of references to
+ * it, and is freed when the last reference is dropped. Interned strings must
+ * not be modified, so that two of them are equal exactly when their pointers
+ * are. The table chains the strings in buckets, doubling them when it holds
+ * as many strings as buckets. Buckets go back to malloc only through
+ * intern_trim(), once no string is held.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Usage counters of a table */
+typedef struct {
+    size_t strings; /* Distinct strings held */
+    size_t refs;    /* References to them */
+    size_t copied;  /* Bytes the strings would take copied once per reference */
+    size_t bytes;   /* Bytes held by the table: strings, headers and buckets */
+} intern_stats_t;
+
+struct intern_entry;
+
+typedef struct {
+    struct intern_entry **buckets;
+    size_t mask; /* Number of buckets, a power of two, minus one */
+    intern_stats_t stats;
+} intern_t;
+
+/* Initializer of an empty table */
+#define INTERN_INIT {.buckets = NULL}
+
+/*
+ * Take a reference to the interned copy of string s of `size` bytes, null
+ * terminator included, interning it if it is not yet.
+ * Return NULL if could not allocate space.
+ */
+char *intern_get(intern_t *table, const char *s, size_t size);
+
+/*
+ * Drop a reference to interned string s, freeing it with the last one.
+ * Return false, with no effect, if s is not a string interned in table.
+ */
+bool intern_put(intern_t *table, const char *s);
+
+/*
+ * Free the buckets of table if it holds no string.
+ */
+void intern_trim(intern_t *table);
+
+#endif /* LAB0_INTERN_H */
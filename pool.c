@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "pool.h"
+
+/* Size of the link word at the beginning of every chunk */
+#define CHUNK_HEADER sizeof(void *)
+
+/* Size of the word in front of every object, telling how it was allocated */
+#define OBJ_HEADER sizeof(void *)
+
+/* Get the word that links an object or a chunk to the next one */
+#define link_of(p) (*(void **) (p))
+
+/* Get the word in front of object p, nonzero if p was allocated by itself */
+#define direct_of(p) (((uintptr_t *) (p))[-1])
+
+/* Bytes each object takes in a chunk, its header included */
+#define slot_size(pool) (OBJ_HEADER + (pool)->obj_size)
+
+/* Bytes of a chunk, its header included */
+#define chunk_size(pool) (CHUNK_HEADER + slot_size(pool) * (pool)->chunk_objs)
+
+/*
+ * Carve objects out of a new chunk, taking a reserved one if available.
+ * Return false if a new chunk could not be allocated.
+ */
+static bool pool_grow(pool_t *pool);
+
+/*
+ * Get an object from pool.
+ * Return NULL if pool is empty and a new chunk could not be allocated.
+ */
+void *pool_alloc(pool_t *pool)
+{
+    void *p;
+    if (pool->direct) {
+        p = malloc(OBJ_HEADER + pool->obj_size);
+        if (!p)
+            return NULL;
+        p = (char *) p + OBJ_HEADER;
+        direct_of(p) = 1;
+        pool->stats.direct++;
+    } else if (pool->free_list) {
+        p = pool->free_list;
+        pool->free_list = link_of(p);
+        pool->free_count--;
+        pool->stats.reuses++;
+    } else {
+        if (pool->next == pool->end && !pool_grow(pool))
+            return NULL;
+        p = pool->next + OBJ_HEADER;
+        direct_of(p) = 0;
+        pool->next += slot_size(pool);
+    }
+    pool->stats.allocs++;
+    pool->stats.in_use++;
+    return p;
+}
+
+/*
+ * Return an object obtained from pool_alloc() to pool.
+ * No effect if p is NULL
+ */
+void pool_free(pool_t *pool, void *p)
+{
+    if (!p)
+        return;
+    pool->stats.in_use--;
+    if (direct_of(p)) {
+        pool->stats.direct--;
+        free((char *) p - OBJ_HEADER);
+        return;
+    }
+    link_of(p) = pool->free_list;
+    pool->free_list = p;
+    pool->free_count++;
+}
+
+/*
+ * Make sure at least n objects can be handed out without allocating.
+ * Return false if a new chunk could not be allocated.
+ */
+bool pool_reserve(pool_t *pool, size_t n)
+{
+    size_t avail;
+    if (pool->direct)
+        return true;
+    avail = pool->free_count + (pool->end - pool->next) / slot_size(pool);
+    for (void *c = pool->spares; c; c = link_of(c))
+        avail += pool->chunk_objs;
+    while (avail < n) {
+        void *c = malloc(chunk_size(pool));
+        if (!c)
+            return false;
+        link_of(c) = pool->spares;
+        pool->spares = c;
+        pool->stats.chunks++;
+        avail += pool->chunk_objs;
+    }
+    return true;
+}
+
+/*
+ * Free all chunks of pool if none of the objects carved out of them is in
+ * use.
+ */
+void pool_trim(pool_t *pool)
+{
+    if (pool->stats.in_use > pool->stats.direct)
+        return;
+    while (pool->chunks) {
+        void *c = pool->chunks;
+        pool->chunks = link_of(c);
+        free(c);
+    }
+    while (pool->spares) {
+        void *c = pool->spares;
+        pool->spares = link_of(c);
+        free(c);
+    }
+    pool->free_list = NULL;
+    pool->free_count = 0;
+    pool->next = pool->end = NULL;
+    pool->stats.chunks = 0;
+}
+
+/*
+ * Select whether the objects handed out from now on are allocated one by one
+ * rather than carved out of chunks. Objects in use may be of either kind.
+ */
+void pool_set_direct(pool_t *pool, bool direct)
+{
+    pool->direct = direct;
+}
+
+/*
+ * Carve objects out of a new chunk, taking a reserved one if available.
+ * Return false if a new chunk could not be allocated.
+ */
+static bool pool_grow(pool_t *pool)
+{
+    void *c = pool->spares;
+    if (c) {
+        pool->spares = link_of(c);
+    } else {
+        c = malloc(chunk_size(pool));
+        if (!c)
+            return false;
+        pool->stats.chunks++;
+    }
+    link_of(c) = pool->chunks;
+    pool->chunks = c;
+    pool->next = (char *) c + CHUNK_HEADER;
+    pool->end = pool->next + slot_size(pool) * pool->chunk_objs;
+    return true;
+}
+
@@ -0,0 +1,80 @@
+#ifndef LAB0_POOL_H
+#define LAB0_POOL_H
+
+/*
+ * Fixed-size object pool.
+ *
+ * Objects are carved out of large chunks obtained from malloc, and released
+ * objects are kept on a free list for reuse instead of being freed. Chunks go
+ * back to malloc only through pool_trim(), once no object is in use, so the
+ * harness still sees every chunk as an allocated block until then.
+ *
+ * Chunks hide the objects in them from the harness: a use after pool_free(),
+ * a double pool_free() or an overrun into the next object goes unnoticed,
+ * and a failing malloc hits once per chunk. In direct mode, set by
+ * pool_set_direct(), objects are allocated and freed one by one instead. A
+ * word in front of each object tells pool_free() which kind it is.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Usage counters of a pool */
+typedef struct {
+    size_t allocs; /* Objects handed out */
+    size_t reuses; /* Objects handed out from the free list */
+    size_t in_use; /* Objects currently handed out */
+    size_t chunks; /* Chunks currently held */
+    size_t direct; /* Objects in use allocated one by one in direct mode */
+} pool_stats_t;
+
+typedef struct {
+    size_t obj_size;   /* Size of each object */
+    size_t chunk_objs; /* Number of objects per chunk */
+    void *free_list;   /* Released objects, linked through their first word */
+    size_t free_count; /* Number of objects on the free list */
+    void *chunks;      /* Chunks in use, linked through their first word */
+    void *spares;      /* Reserved chunks not carved yet, linked likewise */
+    char *next, *end;  /* Space of the newest chunk not yet handed out */
+    bool direct;       /* Whether new objects are allocated one by one */
+    pool_stats_t stats;
+} pool_t;
+
+/* Initializer of a pool handing out chunks of `n` objects of `size` bytes */
+#define POOL_INIT(size, n)                                                  \
+    {                                                                       \
+        .obj_size = ((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1), \
+        .chunk_objs = (n),                                                  \
+    }
+
+/*
+ * Get an object from pool.
+ * Return NULL if pool is empty and a new chunk could not be allocated.
+ */
+void *pool_alloc(pool_t *pool);
+
+/*
+ * Return an object obtained from pool_alloc() to pool.
+ * No effect if p is NULL
+ */
+void pool_free(pool_t *pool, void *p);
+
+/*
+ * Make sure at least n objects can be handed out without allocating.
+ * Return false if a new chunk could not be allocated.
+ */
+bool pool_reserve(pool_t *pool, size_t n);
+
+/*
+ * Free all chunks of pool if none of the objects carved out of them is in
+ * use.
+ */
+void pool_trim(pool_t *pool);
+
+/*
+ * Select whether the objects handed out from now on are allocated one by one
+ * rather than carved out of chunks. Objects in use may be of either kind.
+ */
+void pool_set_direct(pool_t *pool, bool direct);
+
+#endif /* LAB0_POOL_H */
@@ -2,8 +2,12 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <spawn.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +31,9 @@
 /* How much padding should be added to check for string overrun? */
 #define STRINGPAD MAXSTRING
 
+/* Largest buffer for strings removed in one call by rhn */
+#define MAX_RHN_BUFSIZE (1 << 20)
+
 /*
  * It is a bit sketchy to use this #include file on the solution version of the
  * code.
@@ -36,6 +43,13 @@
 #include "queue.h"
 
 #include "console.h"
+#include "queue_blocking.h"
+#include "queue_combining.h"
+#include "queue_lockfree.h"
+#include "queue_sharded.h"
+#include "queue_spsc.h"
+#include "queue_steal.h"
+#include "queue_twolock.h"
 #include "report.h"
 
 /* Settable parameters */
@@ -75,8 +89,34 @@ static int string_length = MAXSTRING;
 #define MAX_RANDSTR_LEN 10
 static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
 
-/* Kernel list_sort flag */
-static int kernelsort = 0;
+/* Sort algorithms selectable with `option sort` */
+enum {
+    SORT_QUEUE,    /* q_sort */
+    SORT_KERNEL,   /* Kernel list_sort */
+    SORT_RADIX,    /* q_sort_radix */
+    SORT_ARRAY,    /* q_sort_array */
+    SORT_PARALLEL, /* q_sort_parallel */
+};
+static int sort_mode = SORT_QUEUE;
+
+/* Number of threads q_sort_parallel sorts with, one per CPU by default */
+static int sort_threads = 1;
+
+/* Largest number of strings passed per bulk insertion */
+#define MAX_BULK 1024
+
+/* Number of strings passed per bulk insertion, one at a time if less than 2 */
+static int bulk_size = 0;
+
+/* Backend of the queues created by `new` */
+static int backend = QUEUE_BACKEND;
+
+/* Whether the strings of new elements are interned */
+static int intern = 0;
+
+/* Number of worker threads the sched command runs tasks with */
+#define SCHED_WORKERS_MAX 64
+static int sched_workers = 4;
 
 /* Forward declarations */
 static bool show_queue(int vlevel);
@@ -156,6 +196,77 @@ static void fill_rand_string(char *buf, size_t buf_size)
     buf[len] = '\0';
 }
 
+/*
+ * Insert string `inserts` reps times, or random strings if `inserts` is NULL,
+ * passing up to bulk_size strings per call.
+ */
+static bool insert_bulk(int option, char *inserts, int reps)
+{
+    // option 0 is for insert head; option 1 is for insert tail
+    static char randstr_bufs[MAX_BULK][MAX_RANDSTR_LEN];
+    char *strs[MAX_BULK];
+    int batch = bulk_size < MAX_BULK ? bulk_size : MAX_BULK;
+    bool ok = true;
+
+    for (int i = 0; i < batch; i++)
+        strs[i] = inserts ? inserts : randstr_bufs[i];
+
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps;) {
+            int n = reps - r < batch ? reps - r : batch;
+            if (!inserts) {
+                for (int i = 0; i < n; i++)
+                    fill_rand_string(randstr_bufs[i], MAX_RANDSTR_LEN);
+            }
+            /* Element at the end inserted to, before and after the batch */
+            element_t *last =
+                option ? q_peek_tail(l_meta.l) : q_peek_head(l_meta.l);
+            int cnt = option ? q_insert_tail_bulk(l_meta.l, strs, n)
+                             : q_insert_head_bulk(l_meta.l, strs, n);
+            lcnt += cnt;
+            l_meta.size += cnt;
+            r += cnt;
+            if (cnt) {
+                element_t *cur =
+                    option ? q_peek_tail(l_meta.l) : q_peek_head(l_meta.l);
+                char *cur_inserts = cur->value;
+                if (!cur_inserts) {
+                    report(1, "ERROR: Failed to save copy of string in queue");
+                    ok = false;
+                } else if (cur_inserts == strs[cnt - 1]) {
+                    report(1,
+                           "ERROR: Need to allocate and copy string for new "
+                           "queue element");
+                    ok = false;
+                    break;
+                } else if (!intern && last && cur_inserts == last->value) {
+                    report(1,
+                           "ERROR: Need to allocate separate string for each "
+                           "queue element");
+                    ok = false;
+                    break;
+                }
+            }
+            if (cnt < n) {
+                /* Skip the string whose insertion failed */
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %s failed", strs[cnt]);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %s failed (%d failures total)",
+                           strs[cnt], fail_count);
+                    ok = false;
+                }
+                r++;
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    return ok;
+}
+
 /* insert head */
 static bool do_ih(int argc, char *argv[])
 {
@@ -199,6 +310,12 @@ static bool do_ih(int argc, char *argv[])
         report(3, "Warning: Calling insert head on null queue");
     error_check();
 
+    if (bulk_size > 1) {
+        ok = insert_bulk(0, need_rand ? NULL : inserts, reps);
+        show_queue(3);
+        return ok;
+    }
+
     if (exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
@@ -207,8 +324,7 @@ static bool do_ih(int argc, char *argv[])
             if (rval) {
                 lcnt++;
                 l_meta.size++;
-                char *cur_inserts =
-                    list_entry(l_meta.l->next, element_t, list)->value;
+                char *cur_inserts = q_peek_head(l_meta.l)->value;
                 if (!cur_inserts) {
                     report(1, "ERROR: Failed to save copy of string in queue");
                     ok = false;
@@ -218,7 +334,7 @@ static bool do_ih(int argc, char *argv[])
                            "queue element");
                     ok = false;
                     break;
-                } else if (r == 1 && lasts == cur_inserts) {
+                } else if (!intern && r == 1 && lasts == cur_inserts) {
                     report(1,
                            "ERROR: Need to allocate separate string for each "
                            "queue element");
@@ -288,6 +404,12 @@ static bool do_it(int argc, char *argv[])
         report(3, "Warning: Calling insert tail on null queue");
     error_check();
 
+    if (bulk_size > 1) {
+        ok = insert_bulk(1, need_rand ? NULL : inserts, reps);
+        show_queue(3);
+        return ok;
+    }
+
     if (exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
@@ -296,8 +418,7 @@ static bool do_it(int argc, char *argv[])
             if (rval) {
                 lcnt++;
                 l_meta.size++;
-                char *cur_inserts =
-                    list_entry(l_meta.l->prev, element_t, list)->value;
+                char *cur_inserts = q_peek_tail(l_meta.l)->value;
                 if (!cur_inserts) {
                     report(1, "ERROR: Failed to save copy of string in queue");
                     ok = false;
@@ -491,39 +612,210 @@ static bool do_rhq(int argc, char *argv[])
     return ok && !error_check();
 }
 
+/* remove n elements from head in one call */
+static bool do_rhn(int argc, char *argv[])
+{
+    int n;
+    if (argc != 2) {
+        report(1, "%s needs 1 argument", argv[0]);
+        return false;
+    }
+    if (!get_int(argv[1], &n) || n < 0) {
+        report(1, "Invalid number of removals '%s'", argv[1]);
+        return false;
+    }
+
+    size_t bufsize = (size_t) (string_length + 1) * n;
+    if (bufsize > MAX_RHN_BUFSIZE)
+        bufsize = MAX_RHN_BUFSIZE;
+    char *removes = malloc(bufsize + STRINGPAD + 1);
+    if (!removes) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for removed strings");
+        return false;
+    }
+    memset(removes, 'X', bufsize + STRINGPAD);
+    removes[bufsize + STRINGPAD] = '\0';
+
+    if (!l_meta.size)
+        report(3, "Warning: Calling remove head on empty queue");
+    error_check();
+
+    LIST_HEAD(out);
+    int cnt = 0;
+    if (exception_setup(true))
+        cnt = q_remove_head_n(l_meta.l, &out, n, removes, bufsize);
+    exception_cancel();
+
+    bool ok = true;
+    int expected = n < lcnt ? n : lcnt;
+    if (cnt != expected) {
+        report(1, "ERROR: Removed %d elements, but expected %d", cnt,
+               expected);
+        ok = false;
+    }
+
+    /* Check the removed elements against the strings copied for them */
+    element_t *item, *tmp;
+    char *sp = removes;
+    int out_cnt = 0;
+    list_for_each_entry_safe (item, tmp, &out, list) {
+        size_t left = bufsize - (sp - removes);
+        if (left) {
+            size_t len = strlen(item->value) + 1;
+            len = len > left ? left : len;
+            if (strncmp(sp, item->value, len - 1) || sp[len - 1] != '\0') {
+                report(1, "ERROR: Removed value %s != copied value %s",
+                       item->value, sp);
+                ok = false;
+            }
+            sp += len;
+        }
+        report(2, "Removed %s from queue", item->value);
+        list_del(&item->list);
+        q_release_element(item);
+        out_cnt++;
+    }
+    if (out_cnt != cnt) {
+        report(1, "ERROR: Removed %d elements, but %d were handed back", cnt,
+               out_cnt);
+        ok = false;
+    }
+
+    int i = bufsize;
+    while (i < bufsize + STRINGPAD && removes[i] == 'X')
+        i++;
+    if (i != bufsize + STRINGPAD) {
+        report(1,
+               "ERROR: copying of strings in remove_head_n overflowed "
+               "destination buffer.");
+        ok = false;
+    }
+
+    lcnt -= out_cnt;
+    l_meta.size -= out_cnt;
+    free(removes);
+    show_queue(3);
+    return ok && !error_check();
+}
+
+/* Release the elements of a list built by copy_queue() */
+static void free_copy(struct list_head *l)
+{
+    element_t *item, *tmp;
+    list_for_each_entry_safe (item, tmp, l, list) {
+        free(item->value);
+        free(item);
+    }
+    INIT_LIST_HEAD(l);
+}
+
+/* List being built by copy_queue() */
+struct queue_copy {
+    struct list_head *l;
+    int cnt;
+};
+
+/* Append a copy of element e to the list. Stop if could not allocate */
+static bool copy_element(element_t *e, void *priv)
+{
+    struct queue_copy *copy = priv;
+    element_t *tmp = malloc(sizeof(element_t));
+    if (!tmp)
+        return false;
+    tmp->value = strdup(e->value);
+    if (!tmp->value) {
+        free(tmp);
+        return false;
+    }
+    list_add_tail(&tmp->list, copy->l);
+    copy->cnt++;
+    return true;
+}
+
+/*
+ * Copy the elements of l_meta.l to list `l`, whose elements are not queue
+ * elements and can be walked directly whatever the queue backend.
+ * Return false, leaving `l` empty, if could not allocate space.
+ */
+static bool copy_queue(struct list_head *l)
+{
+    struct queue_copy copy = {.l = l, .cnt = 0};
+    int cnt = q_for_each(l_meta.l, copy_element, &copy);
+    // Every element visited has been copied unless the copy stopped the walk
+    if (copy.cnt == cnt)
+        return true;
+    free_copy(l);
+    return false;
+}
+
+/* String of an element of a list copy, and its position in the list */
+struct dup_entry {
+    const char *value;
+    int pos;
+};
+
+static int dup_entry_cmp(const void *a, const void *b)
+{
+    return strcmp(((const struct dup_entry *) a)->value,
+                  ((const struct dup_entry *) b)->value);
+}
+
+/*
+ * Set dup[i] to whether the string of the i-th of the cnt elements of list
+ * `l` occurs more than once in it, whatever the order of the list.
+ * Return false if could not allocate space.
+ */
+static bool mark_dups(struct list_head *l, int cnt, bool *dup)
+{
+    struct dup_entry *entries = malloc(cnt * sizeof(struct dup_entry));
+    element_t *item;
+    int i = 0;
+    if (cnt && !entries)
+        return false;
+    list_for_each_entry (item, l, list) {
+        entries[i].value = item->value;
+        entries[i].pos = i;
+        i++;
+    }
+    qsort(entries, cnt, sizeof(struct dup_entry), dup_entry_cmp);
+    for (i = 0; i < cnt; i++) {
+        dup[entries[i].pos] =
+            (i > 0 && !strcmp(entries[i - 1].value, entries[i].value)) ||
+            (i + 1 < cnt && !strcmp(entries[i + 1].value, entries[i].value));
+    }
+    free(entries);
+    return true;
+}
+
 static bool do_dedup(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    bool hash = argc == 2 && !strcmp(argv[1], "hash");
+    if (argc != 1 && !hash) {
+        report(1, "%s takes no arguments, or hash", argv[0]);
         return false;
     }
 
     LIST_HEAD(l_copy);
-    element_t *item, *tmp;
+    LIST_HEAD(l_new);
+    element_t *item;
 
     // Copy l_meta.l to l_copy
-    if (l_meta.l && !list_empty(l_meta.l)) {
-        list_for_each_entry (item, l_meta.l, list) {
-            size_t slen;
-            tmp = malloc(sizeof(element_t));
-            if (!tmp)
-                break;
-            INIT_LIST_HEAD(&tmp->list);
-            slen = strlen(item->value) + 1;
-            tmp->value = malloc(slen);
-            if (!tmp->value) {
-                free(tmp);
-                break;
-            }
-            memcpy(tmp->value, item->value, slen);
-            list_add_tail(&tmp->list, &l_copy);
-        }
-        // Return false if the loop does not leave properly
-        if (&item->list != l_meta.l) {
-            list_for_each_entry_safe (item, tmp, &l_copy, list) {
-                free(item->value);
-                free(item);
-            }
+    if (!copy_queue(&l_copy)) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for "
+               "duplicate checking");
+        return false;
+    }
+
+    // Strings removed by the hash variant need not be next to each other
+    int cnt = q_size(l_meta.l);
+    bool *dup = NULL;
+    if (hash && cnt > 0) {
+        dup = malloc(cnt * sizeof(bool));
+        if (!dup || !mark_dups(&l_copy, cnt, dup)) {
+            free(dup);
+            free_copy(&l_copy);
             report(1,
                    "INTERNAL ERROR.  Could not allocate space for "
                    "duplicate checking");
@@ -533,20 +825,40 @@ static bool do_dedup(int argc, char *argv[])
 
     bool ok = true;
     if (exception_setup(true))
-        ok = q_delete_dup(l_meta.l);
+        ok = hash ? q_delete_dup_hash(l_meta.l) : q_delete_dup(l_meta.l);
     exception_cancel();
 
     if (!ok) {
-        list_for_each_entry_safe (item, tmp, &l_copy, list) {
-            free(item->value);
-            free(item);
+        free(dup);
+        free_copy(&l_copy);
+        if (!l_meta.l) {
+            report(1, "ERROR: Calling delete duplicate on null queue");
+            return false;
+        }
+        // Only the hash table could not be allocated, and the queue is intact
+        fail_count++;
+        if (fail_count < fail_limit) {
+            report(2, "Delete duplicate failed");
+            return !error_check();
         }
-        report(1, "ERROR: Calling delete duplicate on null queue");
+        report(1, "ERROR: Delete duplicate failed (%d failures total)",
+               fail_count);
+        return false;
+    }
+
+    // Copy the remaining elements as well, to walk them alongside l_copy
+    if (!copy_queue(&l_new)) {
+        free(dup);
+        free_copy(&l_copy);
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for "
+               "duplicate checking");
         return false;
     }
 
-    struct list_head *l_tmp = l_meta.l->next;
+    struct list_head *l_tmp = l_new.next;
     bool is_this_dup = false;
+    int i = 0;
     // Compare between new list and old one
     list_for_each_entry (item, &l_copy, list) {
         // Skip comparison with new list if the string is duplicate
@@ -554,11 +866,13 @@ static bool do_dedup(int argc, char *argv[])
             item->list.next != &l_copy &&
             strcmp(list_entry(item->list.next, element_t, list)->value,
                    item->value) == 0;
+        if (hash)
+            is_this_dup = is_next_dup = dup[i++];
         if (is_this_dup || is_next_dup) {
             // Update list size
             lcnt--;
             l_meta.size--;
-        } else if (l_tmp != l_meta.l &&
+        } else if (l_tmp != &l_new &&
                    strcmp(list_entry(l_tmp, element_t, list)->value,
                           item->value) == 0)
             l_tmp = l_tmp->next;
@@ -567,16 +881,15 @@ static bool do_dedup(int argc, char *argv[])
         is_this_dup = is_next_dup;
     }
     // All elements in new list should be traversed
-    ok = ok && l_tmp == l_meta.l;
+    ok = ok && l_tmp == &l_new;
     if (!ok)
         report(1,
                "ERROR: Duplicate strings are in queue or distinct strings are "
                "not in queue");
 
-    list_for_each_entry_safe (item, tmp, &l_copy, list) {
-        free(item->value);
-        free(item);
-    }
+    free(dup);
+    free_copy(&l_copy);
+    free_copy(&l_new);
 
     show_queue(3);
     return ok && !error_check();
@@ -605,6 +918,20 @@ static bool do_reverse(int argc, char *argv[])
 
 static bool do_size(int argc, char *argv[])
 {
+    if (simulation) {
+        if (argc != 1) {
+            report(1, "%s does not need arguments in simulation mode", argv[0]);
+            return false;
+        }
+        bool ok = is_size_const();
+        if (!ok) {
+            report(1, "ERROR: Probably not constant time");
+            return false;
+        }
+        report(1, "Probably constant time");
+        return ok;
+    }
+
     if (argc != 1 && argc != 2) {
         report(1, "%s takes 0-1 arguments", argv[0]);
         return false;
@@ -656,8 +983,31 @@ static int list_cmp(void *_,
                     const struct list_head *a,
                     const struct list_head *b)
 {
-    return strcmp(list_entry(a, element_t, list)->value,
-                  list_entry(b, element_t, list)->value);
+    return q_compare(list_entry(a, element_t, list),
+                     list_entry(b, element_t, list));
+}
+
+/* Whether the elements of l_meta.l are linked into it through `list` */
+#define is_list_backend() \
+    (list_entry(l_meta.l, queue_t, head)->backend == QUEUE_LIST)
+
+/* Walk of a queue checking the order of the elements */
+struct order_check {
+    element_t *prev;
+    bool ok;
+};
+
+/* Check element e against the one visited before it */
+static bool check_ascending(element_t *e, void *priv)
+{
+    struct order_check *check = priv;
+    /* FIXME: add an option to specify sorting order */
+    if (check->prev && strcasecmp(check->prev->value, e->value) > 0) {
+        check->ok = false;
+        return false;
+    }
+    check->prev = e;
+    return true;
 }
 
 bool do_sort(int argc, char *argv[])
@@ -676,30 +1026,54 @@ bool do_sort(int argc, char *argv[])
         report(3, "Warning: Calling sort on single node");
     error_check();
 
+    if (sort_mode == SORT_KERNEL && l_meta.l && !is_list_backend()) {
+        report(1, "ERROR: Kernel sort needs the list backend");
+        return false;
+    }
+
+    /* Scratch array of q_sort_array, allocated before allocation is banned */
+    element_t **scratch = NULL;
+    if (sort_mode == SORT_ARRAY && cnt > 0) {
+        scratch = malloc(cnt * sizeof(element_t *));
+        if (!scratch) {
+            report(1, "INTERNAL ERROR.  Could not allocate space for sorting");
+            return false;
+        }
+    }
+
     set_noallocate_mode(true);
     if (exception_setup(true)) {
-        if (kernelsort)
+        switch (sort_mode) {
+        case SORT_KERNEL:
+            // The kernel sort walks the list itself, from head to tail
+            q_materialize(l_meta.l);
             list_sort(NULL, l_meta.l, list_cmp);
-        else
+            break;
+        case SORT_RADIX:
+            q_sort_radix(l_meta.l);
+            break;
+        case SORT_ARRAY:
+            q_sort_array(l_meta.l, scratch);
+            break;
+        case SORT_PARALLEL:
+            q_sort_parallel(l_meta.l, sort_threads);
+            break;
+        default:
             q_sort(l_meta.l);
+        }
     }
     exception_cancel();
     set_noallocate_mode(false);
+    free(scratch);
 
     bool ok = true;
     if (l_meta.size) {
-        for (struct list_head *cur_l = l_meta.l->next;
-             cur_l != l_meta.l && --cnt; cur_l = cur_l->next) {
-            /* Ensure each element in ascending order */
-            /* FIXME: add an option to specify sorting order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
-            if (strcasecmp(item->value, next_item->value) > 0) {
-                report(1, "ERROR: Not sorted in ascending order");
-                ok = false;
-                break;
-            }
+        /* Ensure each element in ascending order */
+        struct order_check check = {.prev = NULL, .ok = true};
+        q_for_each(l_meta.l, check_ascending, &check);
+        if (!check.ok) {
+            report(1, "ERROR: Not sorted in ascending order");
+            ok = false;
         }
     }
 
@@ -709,6 +1083,20 @@ bool do_sort(int argc, char *argv[])
 
 static bool do_dm(int argc, char *argv[])
 {
+    if (simulation) {
+        if (argc != 1) {
+            report(1, "%s does not need arguments in simulation mode", argv[0]);
+            return false;
+        }
+        bool ok = is_delete_mid_const();
+        if (!ok) {
+            report(1, "ERROR: Probably not constant time");
+            return false;
+        }
+        report(1, "Probably constant time");
+        return ok;
+    }
+
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
@@ -768,6 +1156,25 @@ static bool is_circular()
     return true;
 }
 
+/* Walk of a queue printing the elements */
+struct queue_show {
+    int vlevel;
+    int cnt;
+};
+
+/* Print element e, unless the queue is too long to show it */
+static bool show_element(element_t *e, void *priv)
+{
+    struct queue_show *show = priv;
+    // Stop on more elements than expected, as the queue may be broken
+    if (show->cnt >= lcnt)
+        return false;
+    if (show->cnt < big_list_size)
+        report_noreturn(show->vlevel, show->cnt == 0 ? "%s" : " %s", e->value);
+    show->cnt++;
+    return true;
+}
+
 static bool show_queue(int vlevel)
 {
     bool ok = true;
@@ -780,34 +1187,30 @@ static bool show_queue(int vlevel)
         return true;
     }
 
-    if (!is_circular()) {
+    if (is_list_backend() && !is_circular()) {
         report(vlevel, "ERROR:  Queue is not doubly circular");
         return false;
     }
 
     report_noreturn(vlevel, "l = [");
 
-    struct list_head *ori = l_meta.l;
-    struct list_head *cur = l_meta.l->next;
+    struct queue_show show = {.vlevel = vlevel, .cnt = 0};
+    bool is_whole = false;
 
     if (exception_setup(true)) {
-        while (ok && ori != cur && cnt < lcnt) {
-            element_t *e = list_entry(cur, element_t, list);
-            if (cnt < big_list_size)
-                report_noreturn(vlevel, cnt == 0 ? "%s" : " %s", e->value);
-            cnt++;
-            cur = cur->next;
-            ok = ok && !error_check();
-        }
+        int visited = q_for_each(l_meta.l, show_element, &show);
+        is_whole = visited == show.cnt;
+        ok = !error_check();
     }
     exception_cancel();
+    cnt = show.cnt;
 
     if (!ok) {
         report(vlevel, " ... ]");
         return false;
     }
 
-    if (cur == ori) {
+    if (is_whole) {
         if (cnt <= big_list_size)
             report(vlevel, "]");
         else
@@ -858,6 +1261,12 @@ static bool do_shuffle(int argc, char *argv[])
         report(3, "Warning: Try to access null queue");
     error_check();
 
+    if (l_meta.l && !is_list_backend()) {
+        report(1, "ERROR: Shuffle needs the list backend");
+        return false;
+    }
+
+    q_materialize(l_meta.l);
     if (exception_setup(true))
         q_shuffle(l_meta.l);
     exception_cancel();
@@ -866,65 +1275,1044 @@ static bool do_shuffle(int argc, char *argv[])
     return !error_check();
 }
 
-static bool do_web(int argc, char *argv[])
+static bool do_pool(int argc, char *argv[])
 {
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
     }
-    if (listenfd == -1) {
-        listenfd = get_listenfd();
-        noise = false;
-        set_echo(false);
-        return true;
-    } else {
-        report(1, "web server is already turned on");
+
+    pool_stats_t stats;
+    q_pool_stats(&stats);
+    report(1,
+           "Element pool: %lu allocations, %lu reused (%.1f%% hit rate), "
+           "%lu in use (%lu outside the pool), %lu chunks",
+           stats.allocs, stats.reuses,
+           stats.allocs ? 100.0 * stats.reuses / stats.allocs : 0.0,
+           stats.in_use, stats.direct, stats.chunks);
+    return true;
+}
+
+static bool do_mem(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
         return false;
     }
+
+    report(1, "Heap: %lu bytes in %lu blocks, peak %lu bytes since last mem",
+           allocation_bytes(), allocation_check(), allocation_peak());
+
+    /* Each reference beyond the first of a string would be a block of its
+     * own, holding a copy of the string, without the table
+     */
+    intern_stats_t stats;
+    q_intern_stats(&stats);
+    if (stats.strings) {
+        report(1,
+               "Interned: %lu strings, %lu references, saving %ld bytes in "
+               "%ld blocks",
+               stats.strings, stats.refs, (long) (stats.copied - stats.bytes),
+               (long) (stats.refs - stats.strings - 1));
+    }
+    return true;
 }
 
-static void console_init()
+static bool do_cmp(int argc, char *argv[])
 {
-    ADD_COMMAND(new, "                | Create new queue");
-    ADD_COMMAND(free, "                | Delete queue");
-    ADD_COMMAND(
-        ih,
-        " str [n]        | Insert string str at head of queue n times. "
-        "Generate random string(s) if str equals RAND. (default: n == 1)");
-    ADD_COMMAND(
-        it,
-        " str [n]        | Insert string str at tail of queue n times. "
-        "Generate random string(s) if str equals RAND. (default: n == 1)");
-    ADD_COMMAND(
-        rh,
-        " [str]          | Remove from head of queue.  Optionally compare "
-        "to expected value str");
-    ADD_COMMAND(
-        rt,
-        " [str]          | Remove from tail of queue.  Optionally compare "
-        "to expected value str");
-    ADD_COMMAND(
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    cmp_stats_t stats;
+    q_cmp_stats(&stats);
+    report(1,
+           "Comparisons: %lu since last cmp, %lu decided by key prefix "
+           "(%.1f%%)",
+           stats.compares, stats.by_key,
+           stats.compares ? 100.0 * stats.by_key / stats.compares : 0.0);
+    return true;
+}
+
+/* Concurrent queue driven by the mt command */
+struct mt_variant {
+    const char *name;
+    void *(*create)(void);
+    void (*destroy)(void *q);
+    bool (*insert_tail)(void *q, char *s);
+    element_t *(*remove_head)(void *q, char *sp, size_t bufsize);
+    void (*flush)(void *q); /* Called by each producer when done, if set */
+    bool single;            /* Only for one producer and one consumer */
+};
+
+/* Queue of the q_* functions behind one mutex */
+struct locked_queue {
+    pthread_mutex_t lock;
+    struct list_head *l;
+};
+
+static void *locked_create(void)
+{
+    struct locked_queue *q = malloc(sizeof(struct locked_queue));
+    if (!q)
+        return NULL;
+    q->l = q_new();
+    if (!q->l) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    return q;
+}
+
+static void locked_destroy(void *priv)
+{
+    struct locked_queue *q = priv;
+    q_free(q->l);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+static bool locked_insert_tail(void *priv, char *s)
+{
+    struct locked_queue *q = priv;
+    pthread_mutex_lock(&q->lock);
+    bool ok = q_insert_tail(q->l, s);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static element_t *locked_remove_head(void *priv, char *sp, size_t bufsize)
+{
+    struct locked_queue *q = priv;
+    pthread_mutex_lock(&q->lock);
+    element_t *e = q_remove_head(q->l, sp, bufsize);
+    pthread_mutex_unlock(&q->lock);
+    return e;
+}
+
+static void *lockfree_create(void)
+{
+    return lfq_new();
+}
+
+static void lockfree_destroy(void *q)
+{
+    lfq_free(q);
+}
+
+static bool lockfree_insert_tail(void *q, char *s)
+{
+    return lfq_insert_tail(q, s);
+}
+
+static element_t *lockfree_remove_head(void *q, char *sp, size_t bufsize)
+{
+    return lfq_remove_head(q, sp, bufsize);
+}
+
+static void *twolock_create(void)
+{
+    return tlq_new();
+}
+
+static void twolock_destroy(void *q)
+{
+    tlq_free(q);
+}
+
+static bool twolock_insert_tail(void *q, char *s)
+{
+    return tlq_insert_tail(q, s);
+}
+
+static element_t *twolock_remove_head(void *q, char *sp, size_t bufsize)
+{
+    return tlq_remove_head(q, sp, bufsize);
+}
+
+/* Milliseconds an mt consumer waits for a string of the blocking queue */
+#define MT_WAIT_MS 10
+
+static void *blocking_create(void)
+{
+    return bkq_new();
+}
+
+static void blocking_destroy(void *q)
+{
+    bkq_free(q);
+}
+
+static bool blocking_insert_tail(void *q, char *s)
+{
+    return bkq_insert_tail(q, s);
+}
+
+static element_t *blocking_remove_head(void *q, char *sp, size_t bufsize)
+{
+    return bkq_remove_head(q, sp, bufsize, MT_WAIT_MS);
+}
+
+/* Capacity of the spsc queues of mt, and strings each publish of spsc32 */
+#define MT_RING_SIZE 1024
+#define MT_SPSC_BATCH 32
+
+static void *spsc_create(void)
+{
+    return spq_new(MT_RING_SIZE, 1);
+}
+
+static void *spsc_batch_create(void)
+{
+    return spq_new(MT_RING_SIZE, MT_SPSC_BATCH);
+}
+
+static void spsc_destroy(void *q)
+{
+    spq_free(q);
+}
+
+static bool spsc_insert_tail(void *q, char *s)
+{
+    /* Unlike the other queues, it fills up if the consumer lags behind */
+    while (!spq_room(q)) {
+        spq_publish(q);
+        sched_yield();
+    }
+    return spq_insert_tail(q, s);
+}
+
+static element_t *spsc_remove_head(void *q, char *sp, size_t bufsize)
+{
+    return spq_remove_head(q, sp, bufsize);
+}
+
+static void spsc_flush(void *q)
+{
+    spq_publish(q);
+}
+
+static void *combining_create(void)
+{
+    return fcq_new();
+}
+
+static void combining_destroy(void *q)
+{
+    fcq_free(q);
+}
+
+static bool combining_insert_tail(void *q, char *s)
+{
+    return fcq_insert_tail(q, s);
+}
+
+static element_t *combining_remove_head(void *q, char *sp, size_t bufsize)
+{
+    return fcq_remove_head(q, sp, bufsize);
+}
+
+/* Shards of the sharded queues of mt */
+#define MT_SHARDS 16
+
+static void *sharded_create(void)
+{
+    return shq_new(MT_SHARDS, false);
+}
+
+static void *sharded_strict_create(void)
+{
+    return shq_new(MT_SHARDS, true);
+}
+
+static void sharded_destroy(void *q)
+{
+    shq_free(q);
+}
+
+static bool sharded_insert_tail(void *q, char *s)
+{
+    return shq_insert_tail(q, s);
+}
+
+static element_t *sharded_remove_head(void *q, char *sp, size_t bufsize)
+{
+    return shq_remove_head(q, sp, bufsize);
+}
+
+static const struct mt_variant mt_variants[] = {
+    {"mutex", locked_create, locked_destroy, locked_insert_tail,
+     locked_remove_head},
+    {"lockfree", lockfree_create, lockfree_destroy, lockfree_insert_tail,
+     lockfree_remove_head},
+    {"twolock", twolock_create, twolock_destroy, twolock_insert_tail,
+     twolock_remove_head},
+    {"blocking", blocking_create, blocking_destroy, blocking_insert_tail,
+     blocking_remove_head},
+    {"spsc", spsc_create, spsc_destroy, spsc_insert_tail, spsc_remove_head,
+     spsc_flush, true},
+    {"spsc32", spsc_batch_create, spsc_destroy, spsc_insert_tail,
+     spsc_remove_head, spsc_flush, true},
+    {"combining", combining_create, combining_destroy, combining_insert_tail,
+     combining_remove_head},
+    {"sharded", sharded_create, sharded_destroy, sharded_insert_tail,
+     sharded_remove_head},
+    {"sharded-strict", sharded_strict_create, sharded_destroy,
+     sharded_insert_tail, sharded_remove_head},
+};
+
+/* Most threads of an mt run */
+#define MT_THREADS_MAX LFQ_THREADS_MAX
+
+/* Run of the mt command */
+struct mt_run {
+    const struct mt_variant *v;
+    void *q;
+    int producers;
+    int n;                /* Strings each producer inserts */
+    atomic_int producing; /* Producers still inserting */
+    int *inserted;        /* Strings inserted by each producer */
+    /* Whether each string was removed, string i of producer p at p * n + i */
+    atomic_uchar *seen;
+    atomic_int bad_value, bad_order, twice;
+};
+
+/* Thread of an mt run */
+struct mt_thread {
+    pthread_t thread;
+    struct mt_run *run;
+    int id;
+};
+
+/* Insert strings "id:0", "id:1", ... into the queue of the run */
+static void *mt_produce(void *arg)
+{
+    struct mt_thread *t = arg;
+    struct mt_run *run = t->run;
+    char buf[32];
+    int i;
+    for (i = 0; i < run->n; i++) {
+        snprintf(buf, sizeof(buf), "%d:%d", t->id, i);
+        if (!run->v->insert_tail(run->q, buf))
+            break;
+    }
+    if (run->v->flush)
+        run->v->flush(run->q);
+    run->inserted[t->id] = i;
+    atomic_fetch_sub(&run->producing, 1);
+    return NULL;
+}
+
+/*
+ * Remove strings from the queue of the run until the producers are done and
+ * it is empty, checking that each one is removed once, and that those of any
+ * one producer come in the order they were inserted
+ */
+static void *mt_consume(void *arg)
+{
+    struct mt_thread *t = arg;
+    struct mt_run *run = t->run;
+    int *last = malloc(run->producers * sizeof(int));
+    char buf[32];
+    if (!last)
+        return NULL;
+    for (int p = 0; p < run->producers; p++)
+        last[p] = -1;
+    for (;;) {
+        /* Empty after all producers are done means empty for good */
+        bool done = !atomic_load(&run->producing);
+        element_t *e = run->v->remove_head(run->q, buf, sizeof(buf));
+        int p, i;
+        if (!e) {
+            if (done)
+                break;
+            sched_yield();
+            continue;
+        }
+        if (sscanf(buf, "%d:%d", &p, &i) != 2 || p < 0 ||
+            p >= run->producers || i < 0 || i >= run->n ||
+            strcmp(buf, e->value)) {
+            atomic_fetch_add(&run->bad_value, 1);
+        } else {
+            if (i <= last[p])
+                atomic_fetch_add(&run->bad_order, 1);
+            if (atomic_exchange(&run->seen[(size_t) p * run->n + i], 1))
+                atomic_fetch_add(&run->twice, 1);
+            last[p] = i;
+        }
+        q_release_element(e);
+    }
+    free(last);
+    return NULL;
+}
+
+static bool do_mt(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 5) {
+        report(1, "%s takes 1-4 arguments", argv[0]);
+        return false;
+    }
+
+    struct mt_run run = {.producers = 2, .n = 100000};
+    int consumers = 2;
+    for (size_t i = 0; i < sizeof(mt_variants) / sizeof(mt_variants[0]); i++) {
+        if (!strcmp(argv[1], mt_variants[i].name))
+            run.v = &mt_variants[i];
+    }
+    if (!run.v) {
+        report(1, "Unknown concurrent queue '%s'", argv[1]);
+        return false;
+    }
+    if ((argc > 2 && !get_int(argv[2], &run.producers)) ||
+        (argc > 3 && !get_int(argv[3], &consumers)) ||
+        (argc > 4 && !get_int(argv[4], &run.n)) || run.producers < 1 ||
+        consumers < 1 || run.producers + consumers > MT_THREADS_MAX ||
+        run.n < 0) {
+        report(1,
+               "Need 1 to %d producer and consumer threads in all, and a "
+               "non-negative number of strings",
+               MT_THREADS_MAX);
+        return false;
+    }
+    if (run.v->single && (run.producers > 1 || consumers > 1)) {
+        report(1, "%s takes one producer and one consumer", run.v->name);
+        return false;
+    }
+
+    q_set_threaded(true);
+    int threads = run.producers + consumers;
+    run.q = run.v->create();
+    run.inserted = calloc(run.producers, sizeof(int));
+    run.seen = calloc((size_t) run.producers * run.n, sizeof(atomic_uchar));
+    struct mt_thread *t = calloc(threads, sizeof(struct mt_thread));
+    if (!run.q || !run.inserted || !run.seen || !t) {
+        report(1, "ERROR: Could not allocate space for the run");
+        if (run.q)
+            run.v->destroy(run.q);
+        q_set_threaded(false);
+        free(run.inserted);
+        free(run.seen);
+        free(t);
+        return false;
+    }
+    atomic_init(&run.producing, run.producers);
+
+    /* The threads leave signals to this one, which only waits for them. Long
+     * runs are not timed out, and freeing is not checked block by block.
+     */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    set_cautious_mode(false);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < threads; i++) {
+        bool is_producer = i < run.producers;
+        t[i].run = &run;
+        t[i].id = is_producer ? i : i - run.producers;
+        if (pthread_create(&t[i].thread, NULL,
+                           is_producer ? mt_produce : mt_consume, &t[i])) {
+            /* Consume here if no consumer thread can be spawned */
+            if (is_producer)
+                atomic_fetch_sub(&run.producing, 1);
+            else if (t[i].id == 0)
+                mt_consume(&t[i]);
+            t[i].run = NULL;
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        if (t[i].run)
+            pthread_join(t[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    bool ok = true;
+    long total = 0, missing = 0;
+    for (int p = 0; p < run.producers; p++) {
+        total += run.inserted[p];
+        for (int i = 0; i < run.inserted[p]; i++)
+            missing += !run.seen[(size_t) p * run.n + i];
+    }
+    if (missing || run.bad_value || run.twice) {
+        report(1,
+               "ERROR: %ld strings lost, %d unexpected and %d removed twice",
+               missing, run.bad_value, run.twice);
+        ok = false;
+    }
+    if (run.bad_order) {
+        report(1,
+               "ERROR: %d strings removed before earlier ones of their "
+               "producer",
+               run.bad_order);
+        ok = false;
+    }
+    if (total < (long) run.producers * run.n)
+        report(1, "Warning: Inserted %ld strings out of %ld", total,
+               (long) run.producers * run.n);
+
+    double elapsed = end.tv_sec - start.tv_sec +
+                     (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    report(1,
+           "%s: %d producers, %d consumers, %ld strings in %.3f s, "
+           "%.0f ops/s",
+           run.v->name, run.producers, consumers, total, elapsed,
+           elapsed > 0 ? 2 * total / elapsed : 0.0);
+
+    /* Unchecked as well, as the queue frees the nodes it kept for reuse */
+    run.v->destroy(run.q);
+    q_set_threaded(false);
+    set_cautious_mode(true);
+    free(run.inserted);
+    free(run.seen);
+    free(t);
+    return ok && !error_check();
+}
+
+/* Pause before each handoff of the wake command, for the consumer to block */
+#define WAKE_PAUSE_US 200
+
+/* Run of the wake command */
+struct wake_run {
+    bk_queue_t *q;
+    int fd; /* Eventfd the consumer polls, or -1 to wait in the queue */
+    int n;
+    struct timespec *sent; /* When each string was inserted */
+    double *latency;       /* Microseconds until each string was removed */
+    atomic_int received;
+};
+
+/* Remove the strings of a wake run as soon as they arrive */
+static void *wake_consume(void *arg)
+{
+    struct wake_run *run = arg;
+    struct pollfd pfd = {.fd = run->fd, .events = POLLIN};
+    for (int i = 0; i < run->n;) {
+        element_t *e;
+        if (run->fd >= 0) {
+            poll(&pfd, 1, -1);
+            e = bkq_remove_head(run->q, NULL, 0, 0);
+        } else {
+            e = bkq_remove_head(run->q, NULL, 0, -1);
+        }
+        if (!e)
+            continue;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        run->latency[i] = (now.tv_sec - run->sent[i].tv_sec) * 1000000.0 +
+                          (now.tv_nsec - run->sent[i].tv_nsec) / 1000.0;
+        q_release_element(e);
+        atomic_store(&run->received, ++i);
+    }
+    return NULL;
+}
+
+/* Order latencies, for qsort() */
+static int cmp_latency(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static bool do_wake(int argc, char *argv[])
+{
+    if (argc > 2) {
+        report(1, "%s takes 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    struct wake_run run = {.n = 1000};
+    if ((argc > 1 && !get_int(argv[1], &run.n)) || run.n < 1) {
+        report(1, "Need a positive number of wakeups");
+        return false;
+    }
+
+    run.q = bkq_new();
+    run.sent = malloc(run.n * sizeof(struct timespec));
+    run.latency = malloc(run.n * sizeof(double));
+    if (!run.q || !run.sent || !run.latency || bkq_fd(run.q) < 0) {
+        report(1, "ERROR: Could not allocate space for the run");
+        bkq_free(run.q);
+        free(run.sent);
+        free(run.latency);
+        return false;
+    }
+
+    /* As in mt, the consumer leaves signals to this thread */
+    sigset_t all, old;
+    sigfillset(&all);
+    bool ok = true;
+    for (int by_fd = 0; ok && by_fd < 2; by_fd++) {
+        pthread_t consumer;
+        run.fd = by_fd ? bkq_fd(run.q) : -1;
+        atomic_init(&run.received, 0);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        ok = !pthread_create(&consumer, NULL, wake_consume, &run);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (!ok) {
+            report(1, "ERROR: Could not create consumer thread");
+            break;
+        }
+        for (int i = 0; i < run.n; i++) {
+            /* Hand over the next string once the consumer is asleep again */
+            while (atomic_load(&run.received) < i)
+                sched_yield();
+            usleep(WAKE_PAUSE_US);
+            clock_gettime(CLOCK_MONOTONIC, &run.sent[i]);
+            while (!bkq_insert_tail(run.q, "wake"))
+                ;
+        }
+        pthread_join(consumer, NULL);
+
+        qsort(run.latency, run.n, sizeof(double), cmp_latency);
+        report(1,
+               "%s: %d wakeups, latency min %.1f, median %.1f, 99%% %.1f, "
+               "max %.1f us",
+               by_fd ? "eventfd" : "condvar", run.n, run.latency[0],
+               run.latency[run.n / 2], run.latency[run.n * 99 / 100],
+               run.latency[run.n - 1]);
+    }
+
+    bkq_free(run.q);
+    free(run.sent);
+    free(run.latency);
+    return ok && !error_check();
+}
+
+/* Producer of the feed command, and the queue it feeds the command loop */
+static struct {
+    bk_queue_t *q;
+    pthread_t thread;
+    int n, interval_ms, received;
+} feed;
+
+/* Insert strings "feed:0", "feed:1", ... one every interval_ms */
+static void *feed_produce(void *arg)
+{
+    char buf[32];
+    for (int i = 0; i < feed.n; i++) {
+        if (i)
+            usleep(feed.interval_ms * 1000);
+        snprintf(buf, sizeof(buf), "feed:%d", i);
+        bkq_insert_tail(feed.q, buf);
+    }
+    return NULL;
+}
+
+/* Remove the strings fed so far, and report how many arrived */
+static void feed_drain(void)
+{
+    char buf[32];
+    element_t *e;
+    while ((e = bkq_remove_head(feed.q, buf, sizeof(buf), 0))) {
+        report(2, "Fed %s", buf);
+        q_release_element(e);
+        feed.received++;
+    }
+}
+
+/* Wait for the producer of the feed command, and free its queue */
+static void feed_stop(void)
+{
+    pthread_join(feed.thread, NULL);
+    feed_drain();
+    report(1, "Feed done: %d out of %d strings received", feed.received,
+           feed.n);
+    remove_watch(bkq_fd(feed.q));
+    bkq_free(feed.q);
+    feed.q = NULL;
+}
+
+/* Called by the command loop when the feed queue is not empty */
+static bool feed_ready(int fd)
+{
+    feed_drain();
+    if (feed.received < feed.n)
+        return true;
+    feed_stop();
+    return false;
+}
+
+static bool do_feed(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        report(1, "%s takes 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    int n, interval_ms = 100;
+    if (!get_int(argv[1], &n) ||
+        (argc > 2 && !get_int(argv[2], &interval_ms)) || n < 1 ||
+        interval_ms < 0) {
+        report(1,
+               "Need a positive number of strings and a non-negative "
+               "interval");
+        return false;
+    }
+    if (feed.q) {
+        report(1, "Feed already running");
+        return false;
+    }
+
+    feed.q = bkq_new();
+    int fd = feed.q ? bkq_fd(feed.q) : -1;
+    if (fd < 0 || !add_watch(fd, feed_ready)) {
+        report(1, "ERROR: Could not set up the feed");
+        bkq_free(feed.q);
+        feed.q = NULL;
+        return false;
+    }
+    feed.n = n;
+    feed.interval_ms = interval_ms;
+    feed.received = 0;
+
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&feed.thread, NULL, feed_produce, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err) {
+        report(1, "ERROR: Could not create producer thread");
+        remove_watch(fd);
+        bkq_free(feed.q);
+        feed.q = NULL;
+        return false;
+    }
+    return true;
+}
+
+/* Tasks of the sched command cost 1 to 1 + SCHED_SKEW units of work */
+#define SCHED_SKEW 15
+
+/* Rounds of hashing in each unit of work */
+#define SCHED_UNIT 256
+
+/* Run of the sched command */
+struct sched_run {
+    struct sched_worker *w;
+    int workers;
+    bool steal;       /* Whether idle workers steal tasks of others */
+    atomic_int left;  /* Tasks not run yet */
+    atomic_uint sink; /* Result of the work, so that it is not optimized out */
+};
+
+/* Worker thread of the sched command, running the tasks in its deque */
+struct sched_worker {
+    pthread_t thread;
+    struct sched_run *run;
+    ws_deque_t *d;
+    int id;
+    long units;  /* Work done */
+    int tasks;   /* Tasks run */
+    int stolen;  /* Tasks run that were taken from another worker */
+    double busy; /* Seconds until the worker ran out of tasks */
+};
+
+/* Run the task "i:units" of element e */
+static unsigned sched_task(element_t *e)
+{
+    const char *s = e->value;
+    int units = atoi(strchr(s, ':') + 1);
+    size_t len = strlen(s);
+    unsigned h = 2166136261u;
+    for (long k = 0; k < (long) units * SCHED_UNIT; k++)
+        h = (h ^ (unsigned char) s[k % len]) * 16777619u;
+    return h;
+}
+
+/*
+ * Run tasks of the own deque, newest first, and then, if stealing, the
+ * oldest tasks of randomly chosen other workers, until none are left
+ */
+static void *sched_work(void *arg)
+{
+    struct sched_worker *w = arg;
+    struct sched_run *run = w->run;
+    unsigned seed = w->id, h = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (atomic_load(&run->left)) {
+        element_t *e = wsd_pop(w->d);
+        if (!e && run->steal) {
+            int victim = rand_r(&seed) % run->workers;
+            if (victim != w->id && (e = wsd_steal(run->w[victim].d)))
+                w->stolen++;
+        }
+        if (!e) {
+            if (!run->steal)
+                break;
+            sched_yield();
+            continue;
+        }
+        h ^= sched_task(e);
+        w->units += atoi(strchr(e->value, ':') + 1);
+        w->tasks++;
+        q_release_element(e);
+        atomic_fetch_sub(&run->left, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    w->busy = end.tv_sec - start.tv_sec +
+              (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    atomic_fetch_xor(&run->sink, h);
+    return NULL;
+}
+
+/*
+ * Deal n tasks to the deques of the workers of run, in consecutive blocks.
+ * Task i costs 1 + SCHED_SKEW * i / n units, so the last worker gets the most
+ * work. Each task is an element taken out of a queue built with q_* calls.
+ * Return false if could not allocate space.
+ */
+static bool sched_deal(struct sched_run *run, int n)
+{
+    struct list_head *l = q_new();
+    char buf[32];
+    bool ok = l != NULL;
+    for (int i = 0; ok && i < n; i++) {
+        snprintf(buf, sizeof(buf), "%d:%ld", i,
+                 1 + (long) SCHED_SKEW * i / n);
+        element_t *e = q_insert_tail(l, buf) ? q_remove_head(l, NULL, 0)
+                                             : NULL;
+        ok = e && wsd_push(run->w[(long) i * run->workers / n].d, e);
+        if (e && !ok)
+            q_release_element(e);
+    }
+    q_free(l);
+    return ok;
+}
+
+static bool do_sched(int argc, char *argv[])
+{
+    if (argc > 2) {
+        report(1, "%s takes 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    int n = 10000;
+    if ((argc > 1 && !get_int(argv[1], &n)) || n < 1) {
+        report(1, "Need a positive number of tasks");
+        return false;
+    }
+
+    struct sched_run run = {.workers = sched_workers};
+    run.w = calloc(run.workers, sizeof(struct sched_worker));
+    if (!run.w) {
+        report(1, "ERROR: Could not allocate space for the run");
+        return false;
+    }
+
+    /* As in mt, the workers leave signals to this thread */
+    sigset_t all, old;
+    sigfillset(&all);
+    set_cautious_mode(false);
+    bool ok = true;
+    for (int steal = 0; ok && steal < 2; steal++) {
+        run.steal = steal;
+        for (int i = 0; i < run.workers; i++) {
+            run.w[i] = (struct sched_worker){.run = &run, .id = i};
+            run.w[i].d = wsd_new();
+            ok = ok && run.w[i].d;
+        }
+        ok = ok && sched_deal(&run, n);
+        if (!ok) {
+            report(1, "ERROR: Could not allocate space for the tasks");
+        } else {
+            atomic_init(&run.left, n);
+            pthread_sigmask(SIG_SETMASK, &all, &old);
+            for (int i = 0; i < run.workers; i++) {
+                /* Run the tasks here if no worker thread can be spawned */
+                if (pthread_create(&run.w[i].thread, NULL, sched_work,
+                                   &run.w[i])) {
+                    sched_work(&run.w[i]);
+                    run.w[i].run = NULL;
+                }
+            }
+            for (int i = 0; i < run.workers; i++) {
+                if (run.w[i].run)
+                    pthread_join(run.w[i].thread, NULL);
+            }
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+            long units = 0, most = 0;
+            int stolen = 0;
+            double makespan = 0;
+            for (int i = 0; i < run.workers; i++) {
+                struct sched_worker *w = &run.w[i];
+                report(2, "  worker %d: %d tasks, %d stolen, %ld units, %.3f s",
+                       i, w->tasks, w->stolen, w->units, w->busy);
+                units += w->units;
+                stolen += w->stolen;
+                if (w->units > most)
+                    most = w->units;
+                if (w->busy > makespan)
+                    makespan = w->busy;
+            }
+            /* Workers idle before the last one is done */
+            double idle = 0;
+            for (int i = 0; i < run.workers; i++)
+                idle += makespan - run.w[i].busy;
+            report(1,
+                   "%s: %d workers, %d tasks in %.3f s, %d stolen, busiest "
+                   "worker did %.1f%% of the work (fair share %.1f%%), "
+                   "%.1f%% idle",
+                   steal ? "stealing" : "static", run.workers, n, makespan,
+                   stolen, 100.0 * most / units, 100.0 / run.workers,
+                   makespan > 0 ? 100.0 * idle / (run.workers * makespan)
+                                : 0.0);
+        }
+        for (int i = 0; i < run.workers; i++)
+            wsd_free(run.w[i].d);
+    }
+    set_cautious_mode(true);
+
+    free(run.w);
+    return ok && !error_check();
+}
+
+static bool do_web(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+    if (listenfd == -1) {
+        listenfd = get_listenfd();
+        noise = false;
+        set_echo(false);
+        return true;
+    } else {
+        report(1, "web server is already turned on");
+        return false;
+    }
+}
+
+/* Make queues created from now on use the backend just set */
+static void set_backend(int oldval)
+{
+    if (!q_set_backend(backend)) {
+        report(1, "ERROR: Unknown backend %d", backend);
+        backend = oldval;
+    }
+}
+
+/* Allocate elements one by one while malloc may fail, for the harness checks */
+static void set_malloc(int oldval)
+{
+    q_set_pool(fail_probability == 0);
+}
+
+static void set_intern(int oldval)
+{
+    q_set_intern(intern);
+}
+
+/* Keep the worker count of sched in range */
+static void set_workers(int oldval)
+{
+    if (sched_workers < 1 || sched_workers > SCHED_WORKERS_MAX) {
+        report(1, "ERROR: Worker count must be between 1 and %d",
+               SCHED_WORKERS_MAX);
+        sched_workers = oldval;
+    }
+}
+
+/* Keep the thread count of q_sort_parallel in range */
+static void set_threads(int oldval)
+{
+    if (sort_threads < 1 || sort_threads > SORT_THREADS_MAX) {
+        report(1, "ERROR: Thread count must be between 1 and %d",
+               SORT_THREADS_MAX);
+        sort_threads = oldval;
+    }
+}
+
+static void console_init()
+{
+    ADD_COMMAND(new, "                | Create new queue");
+    ADD_COMMAND(free, "                | Delete queue");
+    ADD_COMMAND(
+        ih,
+        " str [n]        | Insert string str at head of queue n times. "
+        "Generate random string(s) if str equals RAND. (default: n == 1)");
+    ADD_COMMAND(
+        it,
+        " str [n]        | Insert string str at tail of queue n times. "
+        "Generate random string(s) if str equals RAND. (default: n == 1)");
+    ADD_COMMAND(
+        rh,
+        " [str]          | Remove from head of queue.  Optionally compare "
+        "to expected value str");
+    ADD_COMMAND(
+        rt,
+        " [str]          | Remove from tail of queue.  Optionally compare "
+        "to expected value str");
+    ADD_COMMAND(
         rhq,
         "                | Remove from head of queue without reporting value.");
+    ADD_COMMAND(rhn,
+                " n              | Remove n elements from head of queue in one "
+                "call");
     ADD_COMMAND(reverse, "                | Reverse queue");
     ADD_COMMAND(sort, "                | Sort queue in ascending order");
     ADD_COMMAND(
         size, " [n]            | Compute queue size n times (default: n == 1)");
     ADD_COMMAND(show, "                | Show queue contents");
     ADD_COMMAND(dm, "                | Delete middle node in queue");
-    ADD_COMMAND(
-        dedup, "                | Delete all nodes that have duplicate string");
+    ADD_COMMAND(dedup,
+                " [hash]         | Delete all nodes that have duplicate "
+                "string. With hash, the queue need not be sorted");
     ADD_COMMAND(swap,
                 "                | Swap every two adjacent nodes in queue");
     ADD_COMMAND(shuffle, "                | Shuffle nodes in queue");
+    ADD_COMMAND(pool, "                | Show element pool statistics");
+    ADD_COMMAND(mem, "                | Show heap usage of the queue");
+    ADD_COMMAND(cmp, "                | Show comparisons made since last cmp");
+    ADD_COMMAND(mt,
+                " q [p c n]      | Pass n strings from each of p producer "
+                "threads to c consumer threads through concurrent queue q "
+                "(mutex, lockfree, twolock, blocking, combining, sharded, "
+                "sharded-strict, spsc, spsc32 with p == c == 1), and report "
+                "throughput "
+                "(default: p == 2, c == 2, n == 100000)");
+    ADD_COMMAND(wake,
+                " [n]            | Measure the latency of n wakeups of a "
+                "consumer blocked on a condition variable, then on an eventfd "
+                "(default: n == 1000)");
+    ADD_COMMAND(feed,
+                " n [ms]         | Have a thread insert n strings into a "
+                "blocking queue, one every ms milliseconds, for the command "
+                "loop to remove as its eventfd gets readable "
+                "(default: ms == 100)");
+    ADD_COMMAND(sched,
+                " [n]            | Run n tasks of growing cost, dealt in "
+                "blocks to the work-stealing deques of the workers, first "
+                "without and then with stealing (default: n == 10000)");
     ADD_COMMAND(web, "                | Response to web client");
     add_param("length", &string_length, "Maximum length of displayed string",
               NULL);
     add_param("malloc", &fail_probability, "Malloc failure probability percent",
-              NULL);
+              set_malloc);
     add_param("fail", &fail_limit,
               "Number of times allow queue operations to return false", NULL);
-    add_param("sort", &kernelsort, "Enable/disable kernel version sort", NULL);
+    add_param("sort", &sort_mode,
+              "Sort algorithm (0: q_sort, 1: kernel list_sort, 2: radix, "
+              "3: pointer array, 4: parallel)",
+              NULL);
+    add_param("threads", &sort_threads, "Number of threads of parallel sort",
+              set_threads);
+    add_param("bulk", &bulk_size,
+              "Number of strings inserted per call by ih/it (0: one by one)",
+              NULL);
+    add_param("backend", &backend,
+              "Backend of new queues (0: list, 1: unrolled, 2: ring)",
+              set_backend);
+    add_param("workers", &sched_workers, "Number of worker threads of sched",
+              set_workers);
+    add_param("intern", &intern,
+              "Whether new elements share interned copies of equal strings",
+              set_intern);
 }
 
 /* Signal handlers */
@@ -948,12 +2336,18 @@ static void queue_init()
 {
     fail_count = 0;
     l_meta.l = NULL;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    sort_threads = cpus < 1 ? 1 : cpus > SORT_THREADS_MAX ? SORT_THREADS_MAX
+                                                           : cpus;
     signal(SIGSEGV, sigsegvhandler);
     signal(SIGALRM, sigalrmhandler);
 }
 
 static bool queue_quit(int argc, char *argv[])
 {
+    if (feed.q)
+        feed_stop();
+
     report(3, "Freeing queue");
     if (lcnt > big_list_size)
         set_cautious_mode(false);
@@ -1,9 +1,13 @@
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "harness.h"
-#include "queue.h"
+#include "queue_backend.h"
 
 /* Notice: sometimes, Cppcheck would find the potential NULL pointer bugs,
  * but some of them cannot occur. You can suppress them by adding the
@@ -11,12 +15,213 @@
  *   cppcheck-suppress nullPointer
  */
 
+/* Operations of each backend. The list backend is implemented in this file */
+static const struct queue_ops *const backend_ops[] = {
+    [QUEUE_LIST] = NULL,
+    [QUEUE_UNROLLED] = &unrolled_ops,
+    [QUEUE_RING] = &ring_ops,
+};
+
+/* Backend of the queues created from now on */
+static queue_backend_t new_backend = QUEUE_BACKEND;
+
+/* Whether the strings of the elements created from now on are interned */
+static bool intern_strings = false;
+
+/* Table of the strings interned for elements of all queues */
+static intern_t string_table = INTERN_INIT;
+
+/* Number of concurrent queues in use, which create and release elements from
+ * several threads while it is nonzero. Atomic, as a queue may be created while
+ * the threads of another are running.
+ */
+static atomic_int alloc_threaded = 0;
+
+/* Lock of the element pool and the string table, once alloc_threaded */
+static pthread_mutex_t alloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Signal mask of the thread holding alloc_mutex, from before it blocked
+ * SIGALRM
+ */
+static sigset_t alloc_mask;
+
+/*
+ * Take alloc_mutex once alloc_threaded. SIGALRM stays blocked until
+ * alloc_unlock(), so that the time limit of exception_setup() cannot jump out
+ * with the mutex held.
+ */
+static inline void alloc_lock(void)
+{
+    sigset_t alarm, old;
+    if (!alloc_threaded)
+        return;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm, &old);
+    pthread_mutex_lock(&alloc_mutex);
+    alloc_mask = old;
+}
+
+static inline void alloc_unlock(void)
+{
+    sigset_t old;
+    if (!alloc_threaded)
+        return;
+    old = alloc_mask;
+    pthread_mutex_unlock(&alloc_mutex);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/* Counters of element_cmp(), one set per thread */
+_Thread_local cmp_stats_t cmp_stats;
+
+/* Part of a queue sorted by a thread of q_sort_parallel() */
+struct sort_task {
+    pthread_t thread;
+    struct list_head *chain; /* NULL-terminated chain, sorted in place */
+    cmp_stats_t stats;       /* Comparisons made by the thread */
+};
+
+/* Get the backend operations of queue `h`, or NULL for the list backend */
+#define ops_of(h) backend_ops[queue_of(h)->backend]
+
+/* Whether a string of `slen` bytes is stored inside its element */
+#ifdef ELEMENT_PACKED
+#define element_inline(slen) true
+#else
+#define element_inline(slen) ((slen) <= ELEMENT_INLINE_SIZE)
+#endif
+
+/*
+ * Elements of up to this size, inline string included, are allocated from
+ * the element pool. This covers every element unless built with
+ * ELEMENT_PACKED, where elements holding long strings come from malloc.
+ */
+#define ELEMENT_SLOT_SIZE (sizeof(element_t) + ELEMENT_INLINE_SIZE)
+
+/* Number of elements per chunk of the element pool */
+#define ELEMENT_CHUNK_SIZE 256
+
+/* Radix sort insertion sorts buckets of up to this many elements */
+#define RADIX_INSERTION_MAX 16
+
+/*
+ * Radix sort merge sorts buckets whose strings share this many leading bytes,
+ * which bounds its recursion, and its stack of about 5 KiB per level.
+ */
+#define RADIX_MAX_DEPTH 16
+
+/* Merge sort extends runs shorter than this to this length */
+#define MIN_RUN 16
+
+/* Merge sort gallops in a run which wins this many times in a row */
+#define MIN_GALLOP 7
+
+/*
+ * Most runs pending in merge sort. Their lengths grow at least as fast as the
+ * Fibonacci numbers from the top, so this covers any queue an int can count.
+ */
+#define MERGE_PENDING_MAX 48
+
+/* Slot of the table of strings counted by q_delete_dup_hash() */
+struct dup_slot {
+    element_t *e; /* First element holding the string, NULL if slot is free */
+    uint32_t hash;
+    int cnt; /* Number of elements holding the string */
+};
+
+/* Open addressing table of q_delete_dup_hash(), probed linearly */
+struct dup_table {
+    struct dup_slot *slots;
+    size_t mask; /* Capacity, a power of two, minus one */
+};
+
+/* Sorted chain of elements taken by merge sort */
+struct run {
+    struct list_head *head, *tail;
+    int len;
+};
+
+/* Pool shared by the elements of all queues */
+static pool_t element_pool = POOL_INIT(ELEMENT_SLOT_SIZE, ELEMENT_CHUNK_SIZE);
+
+/* Whether an element with a string of `slen` bytes fits in a pool slot with
+ * its string, and so may go through the cache of a thread
+ */
+#define element_cached(slen) \
+    (element_inline(slen) && sizeof(element_t) + (slen) <= ELEMENT_SLOT_SIZE)
+
+/* Number of elements moved between a thread cache and the pool at once */
+#define ELEMENT_CACHE_BATCH 64
+
+/*
+ * Pool elements kept by a thread once alloc_threaded, linked through
+ * `list.next`, so that elements with inline strings are created and released
+ * without alloc_lock() but once per ELEMENT_CACHE_BATCH of them. The pool
+ * counts them as in use until they are handed back.
+ */
+struct element_cache {
+    struct list_head *free;
+    int cnt;
+    bool registered; /* Whether it is handed back when the thread exits */
+};
+
+static _Thread_local struct element_cache element_cache;
+
+/* Key whose destructor hands the cache of an exiting thread back */
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Return the cache of the calling thread, making sure that it is handed back
+ * when the thread exits.
+ */
+static struct element_cache *thread_cache(void);
+
+/*
+ * Take an element from the cache of the calling thread, refilling it from the
+ * element pool if it is empty.
+ * Return NULL if could not allocate space.
+ */
+static element_t *cache_get(void);
+
+/*
+ * Put pool element e into the cache of the calling thread, handing a batch
+ * back to the element pool once it holds two.
+ */
+static void cache_put(element_t *e);
+
+/*
+ * Hand all elements of `cache`, a struct element_cache, back to the element
+ * pool.
+ */
+static void cache_flush(void *cache);
+
+/*
+ * Create the key which hands the cache of each thread back when it exits.
+ */
+static void cache_key_create(void);
+
 /*
- * Create an element with string initialized.
+ * Create an element with string initialized. The caller holds alloc_lock().
  * Return NULL if could not allocate space or `s` is NULL.
  */
 static element_t *alloc_helper(const char *s);
 
+/*
+ * Return the first 8 bytes of string s of slen bytes, null terminator
+ * included, as a big-endian integer, zero padded.
+ */
+static uint64_t string_key(const char *s, size_t slen);
+
+/*
+ * Create elements for strings s[0], ..., s[n - 1] and link them into `chain`,
+ * each one before the previous if `reverse` is true, after it otherwise.
+ * Stop at the first string that could not be allocated.
+ * Return number of elements created.
+ */
+static int alloc_chain(struct list_head *chain, char **s, int n, bool reverse);
+
 /*
  * Attempt to remove node from a queue.
  * Return target element.
@@ -24,7 +229,130 @@ static element_t *alloc_helper(const char *s);
  * If sp is non-NULL and an element is removed, copy the removed string to *sp
  * (up to a maximum of bufsize-1 characters, plus a null terminator.)
  */
-static element_t *my_q_remove(struct list_head *node, char *sp, size_t bufsize);
+static element_t *my_q_remove(struct list_head *head,
+                              struct list_head *node,
+                              char *sp,
+                              size_t bufsize);
+
+/*
+ * Account for element e having been unlinked from queue.
+ * Return e.
+ * If sp is non-NULL, copy the removed string to *sp as in my_q_remove.
+ */
+static element_t *finish_remove(struct list_head *head,
+                                element_t *e,
+                                char *sp,
+                                size_t bufsize);
+
+/*
+ * Copy the strings of the elements in `list` to *sp back to back, each with
+ * its null terminator, until they do not fit in bufsize bytes any more.
+ * The first string that does not fit is truncated to fill up the space left.
+ */
+static void copy_strings(const struct list_head *list,
+                         char *sp,
+                         size_t bufsize);
+
+/*
+ * Sort a NULL-terminated chain of elements linked through `list.next` in
+ * ascending order with a stable merge sort.
+ * Return the sorted chain.
+ */
+static struct list_head *merge_sort(struct list_head *list);
+
+/*
+ * Take the run at the front of chain `list` into *run, reversing it if it is
+ * strictly descending, and extend it to MIN_RUN elements if shorter by
+ * inserting the following ones.
+ * Return the rest of the chain.
+ */
+static struct list_head *next_run(struct list_head *list, struct run *run);
+
+/*
+ * Return the last node of the stretch of chain `node` whose elements go before
+ * element `key`, those less than it, or also equal to it if `with_equal` is
+ * true. Node `node` itself must go before it.
+ */
+static struct list_head *gallop(struct list_head *node,
+                                const element_t *key,
+                                bool with_equal);
+
+/*
+ * Merge run b into run a which precedes it, keeping the elements of `a` first
+ * among equal ones. Runs already in order are joined at once, and once one
+ * run wins MIN_GALLOP times in a row, the stretch of its elements which goes
+ * before the other run's front is found with gallop() and moved as a whole.
+ */
+static void merge_runs(struct run *a, struct run *b);
+
+/* Whether the element of node `node` is less than element `key`, or equal to
+ * it if `with_equal` is true
+ */
+#define goes_before(node, key, with_equal) \
+    (element_cmp(list_entry(node, element_t, list), key) < (with_equal))
+
+/*
+ * Sort chain `list` of n elements, whose strings share their first `depth`
+ * bytes, by distributing them on the following bytes, and link the sorted
+ * chain at *tail.
+ * Return the link field of the last element of the sorted chain.
+ */
+static struct list_head **radix_sort(struct list_head *list,
+                                     int n,
+                                     size_t depth,
+                                     struct list_head **tail);
+
+/*
+ * Link the elements of NULL-terminated chain `list` into list `head`, in
+ * chain order, setting their `prev` links on the way.
+ */
+static void relink_chain(struct list_head *head, struct list_head *list);
+
+/*
+ * Thread body of q_sort_parallel(): sort the chain of struct sort_task `arg`.
+ */
+static void *sort_task_run(void *arg);
+
+/*
+ * Return the slot of table t holding the string of element e, or the free
+ * slot where it would go.
+ */
+static struct dup_slot *dup_slot_of(struct dup_table *t, element_t *e);
+
+/*
+ * Count the string of element e in struct dup_table `priv`, as a q_visit_t.
+ */
+static bool count_string(element_t *e, void *priv);
+
+/*
+ * Return whether the string of element e is counted once in struct dup_table
+ * `priv`, as a q_visit_t.
+ */
+static bool is_unique(element_t *e, void *priv);
+
+/*
+ * Merge k sorted NULL-terminated chains into empty list `head`, taking the
+ * least of the elements at the front of all chains at each step, through a
+ * heap of the chains. Elements of chains[i] go before those of chains[j]
+ * among equal ones if i < j.
+ */
+static void merge_k_chains(struct list_head *head,
+                           struct list_head **chains,
+                           int k);
+
+/*
+ * Restore the heap order of chain indices heap[0], ..., heap[n - 1] from
+ * position `pos` down, after the front of chain heap[pos] has changed.
+ */
+static void sift_chains(struct list_head **chains, int *heap, int n, int pos);
+
+/* Whether the front element of chains[i] goes before that of chains[j] */
+static inline bool chain_before(struct list_head **chains, int i, int j)
+{
+    int cmp = element_cmp(list_entry(chains[i], element_t, list),
+                          list_entry(chains[j], element_t, list));
+    return cmp < 0 || (cmp == 0 && i < j);
+}
 
 /*
  * Get the middle node in list.
@@ -37,6 +365,39 @@ static element_t *my_q_remove(struct list_head *node, char *sp, size_t bufsize);
  */
 static struct list_head *get_mid_node(const struct list_head *head);
 
+/*
+ * Insert an element for string s at the head of the storage of the queue if
+ * `at_head` is true, at its tail otherwise.
+ * Return false if could not allocate space.
+ */
+static bool insert_at(struct list_head *head, char *s, bool at_head);
+
+/*
+ * Insert elements for strings s[0], ..., s[n - 1] in turn at the head of the
+ * storage of the queue if `at_head` is true, at its tail otherwise.
+ * Return number of strings inserted.
+ */
+static int insert_bulk_at(struct list_head *head,
+                          char **s,
+                          int n,
+                          bool at_head);
+
+/*
+ * Remove the element at the head of the storage of a non-empty queue if
+ * `at_head` is true, at its tail otherwise.
+ * Return the element, whose string is copied to *sp as in my_q_remove.
+ */
+static element_t *remove_at(struct list_head *head,
+                            bool at_head,
+                            char *sp,
+                            size_t bufsize);
+
+/*
+ * Return the element at the head of the storage of a non-empty queue if
+ * `at_head` is true, at its tail otherwise.
+ */
+static element_t *peek_at(struct list_head *head, bool at_head);
+
 /*
  * Create empty queue.
  * Return NULL if could not allocate space.
@@ -44,11 +405,26 @@ static struct list_head *get_mid_node(const struct list_head *head);
 struct list_head *q_new()
 {
     /* Malloc queue. */
-    struct list_head *const q = malloc(sizeof(struct list_head));
-    /* Initialize queue if `q` is not NULL. */
-    if (q)
-        INIT_LIST_HEAD(q);
-    return q;
+    queue_t *const q = malloc(sizeof(queue_t));
+    if (!q)
+        return NULL;
+    /* Initialize queue. */
+    INIT_LIST_HEAD(&q->head);
+    q->size = 0;
+    q->backend = new_backend;
+    q->reversed = false;
+    q->mid = NULL;
+    if (ops_of(&q->head) && !ops_of(&q->head)->init(&q->head)) {
+        free(q);
+        return NULL;
+    }
+    /* Have room for the first element, so that it is not slower to insert.
+     * Failing here is fine, the pool grows on demand anyway.
+     */
+    alloc_lock();
+    pool_reserve(&element_pool, 1);
+    alloc_unlock();
+    return &q->head;
 }
 
 /* Free all storage used by queue */
@@ -57,9 +433,13 @@ void q_free(struct list_head *l)
     element_t *i, *tmp;
     if (!l)
         return;
-    list_for_each_entry_safe (i, tmp, l, list)
-        q_release_element(i);
-    free(l);
+    if (ops_of(l))
+        ops_of(l)->free(l);
+    else
+        list_for_each_entry_safe (i, tmp, l, list)
+            element_free(i);
+    free(queue_of(l));
+    element_trim();
 }
 
 /*
@@ -71,14 +451,7 @@ void q_free(struct list_head *l)
  */
 bool q_insert_head(struct list_head *head, char *s)
 {
-    element_t *element;
-    if (!head)
-        return false;
-    element = alloc_helper(s);
-    if (!element)
-        return false;
-    list_add(&element->list, head);
-    return true;
+    return head && insert_at(head, s, !queue_of(head)->reversed);
 }
 
 /*
@@ -90,14 +463,29 @@ bool q_insert_head(struct list_head *head, char *s)
  */
 bool q_insert_tail(struct list_head *head, char *s)
 {
-    element_t *element;
-    if (!head)
-        return false;
-    element = alloc_helper(s);
-    if (!element)
-        return false;
-    list_add_tail(&element->list, head);
-    return true;
+    return head && insert_at(head, s, queue_of(head)->reversed);
+}
+
+/*
+ * Attempt to insert n elements at head of queue, with the same effect as
+ * calling q_insert_head() for s[0], s[1], ..., s[n - 1] in turn.
+ * The elements are allocated in one batch and linked into the queue at once.
+ * Return number of strings inserted, which is less than n if q is NULL or
+ * space could not be allocated for the string following the inserted ones.
+ */
+int q_insert_head_bulk(struct list_head *head, char **s, int n)
+{
+    return head ? insert_bulk_at(head, s, n, !queue_of(head)->reversed) : 0;
+}
+
+/*
+ * Attempt to insert n elements at tail of queue, with the same effect as
+ * calling q_insert_tail() for s[0], s[1], ..., s[n - 1] in turn.
+ * Other attribute is as same as q_insert_head_bulk.
+ */
+int q_insert_tail_bulk(struct list_head *head, char **s, int n)
+{
+    return head ? insert_bulk_at(head, s, n, queue_of(head)->reversed) : 0;
 }
 
 /*
@@ -116,8 +504,9 @@ bool q_insert_tail(struct list_head *head, char *s)
  */
 element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
 {
-    return !head || list_empty(head) ? NULL
-                                     : my_q_remove(head->next, sp, bufsize);
+    if (!head || !queue_of(head)->size)
+        return NULL;
+    return remove_at(head, !queue_of(head)->reversed, sp, bufsize);
 }
 
 /*
@@ -126,8 +515,64 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
 {
-    return !head || list_empty(head) ? NULL
-                                     : my_q_remove(head->prev, sp, bufsize);
+    if (!head || !queue_of(head)->size)
+        return NULL;
+    return remove_at(head, queue_of(head)->reversed, sp, bufsize);
+}
+
+/*
+ * Attempt to remove up to n elements from head of queue in one operation.
+ * The removed elements are moved, in queue order, to the tail of list `out`.
+ * If sp is non-NULL, the removed strings are also copied to *sp back to back,
+ * each with its null terminator, as long as they fit in bufsize bytes. The
+ * first string that does not fit is truncated as in q_remove_head, and the
+ * ones following it are not copied.
+ * Return number of elements removed.
+ * Return 0 if queue is NULL or empty, or out is NULL.
+ *
+ * NOTE: as in q_remove_head, the removed elements are unlinked, not freed.
+ */
+int q_remove_head_n(struct list_head *head,
+                    struct list_head *out,
+                    int n,
+                    char *sp,
+                    size_t bufsize)
+{
+    LIST_HEAD(cut);
+    struct list_head *last = head;
+    int size;
+    if (!head || !out || !queue_of(head)->size || n <= 0)
+        return 0;
+    size = queue_of(head)->size;
+    n = n < size ? n : size;
+    queue_of(head)->mid = NULL;
+    if (ops_of(head)) {
+        for (int i = 0; i < n; i++) {
+            element_t *const e = queue_of(head)->reversed
+                                     ? ops_of(head)->remove_tail(head)
+                                     : ops_of(head)->remove_head(head);
+            list_add_tail(&e->list, &cut);
+        }
+    } else if (queue_of(head)->reversed) {
+        // The elements to remove are at the tail of the list, last first
+        for (int i = 0; i < n; i++)
+            list_move_tail(head->prev, &cut);
+    } else {
+        // Walk from whichever end is closer to the last node to remove
+        if (n <= size / 2) {
+            for (int i = 0; i < n; i++)
+                last = last->next;
+        } else {
+            for (int i = size; i >= n; i--)
+                last = last->prev;
+        }
+        list_cut_position(&cut, head, last);
+    }
+    queue_of(head)->size -= n;
+    if (sp && bufsize)
+        copy_strings(&cut, sp, bufsize);
+    list_splice_tail(&cut, out);
+    return n;
 }
 
 /*
@@ -136,23 +581,70 @@ element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
  */
 void q_release_element(element_t *e)
 {
-    free(e->value);
-    free(e);
+    element_free(e);
+}
+
+/*
+ * Return element at head of queue without removing it.
+ * Return NULL if queue is NULL or empty.
+ */
+element_t *q_peek_head(struct list_head *head)
+{
+    if (!head || !queue_of(head)->size)
+        return NULL;
+    return peek_at(head, !queue_of(head)->reversed);
+}
+
+/*
+ * Return element at tail of queue without removing it.
+ * Return NULL if queue is NULL or empty.
+ */
+element_t *q_peek_tail(struct list_head *head)
+{
+    if (!head || !queue_of(head)->size)
+        return NULL;
+    return peek_at(head, queue_of(head)->reversed);
+}
+
+/*
+ * Call visit(e, priv) for each element e from head to tail of queue, until it
+ * returns false. The elements must not be removed during the walk.
+ * Return number of elements visited.
+ * Return 0 if queue is NULL or empty.
+ */
+int q_for_each(struct list_head *head, q_visit_t visit, void *priv)
+{
+    element_t *e;
+    int cnt = 0;
+    if (!head)
+        return 0;
+    if (queue_of(head)->reversed && !ops_of(head)) {
+        for (struct list_head *node = head->prev; node != head;
+             node = node->prev) {
+            cnt++;
+            if (!visit(list_entry(node, element_t, list), priv))
+                break;
+        }
+        return cnt;
+    }
+    if (ops_of(head))
+        return ops_of(head)->for_each(head, queue_of(head)->reversed, visit,
+                                      priv);
+    list_for_each_entry (e, head, list) {
+        cnt++;
+        if (!visit(e, priv))
+            break;
+    }
+    return cnt;
 }
 
 /*
- * Return number of elements in queue.
+ * Return number of elements in queue in constant time.
  * Return 0 if q is NULL or empty
  */
 int q_size(struct list_head *head)
 {
-    int len = 0;
-    struct list_head *li;
-    if (!head || list_empty(head))
-        return 0;
-    list_for_each (li, head)
-        len++;
-    return len;
+    return head ? queue_of(head)->size : 0;
 }
 
 /*
@@ -166,9 +658,30 @@ int q_size(struct list_head *head)
 bool q_delete_mid(struct list_head *head)
 {
     // https://leetcode.com/problems/delete-the-middle-node-of-a-linked-list/
-    if (!head || list_empty(head))
+    struct list_head *mid;
+    if (!head || !queue_of(head)->size)
         return false;
-    q_release_element(my_q_remove(get_mid_node(head), NULL, 0));
+    // Counted from the tail of the storage, the middle of an even number of
+    // elements is the one before the middle counted from its head
+    if (ops_of(head)) {
+        if (queue_of(head)->reversed && !(queue_of(head)->size & 1))
+            q_materialize(head);
+        element_free(
+            finish_remove(head, ops_of(head)->remove_mid(head), NULL, 0));
+        return true;
+    }
+    if (!queue_of(head)->mid)
+        queue_of(head)->mid = get_mid_node(head);
+    mid = queue_of(head)->mid;
+    // The node after the middle moves into its place if the count was odd,
+    // the one before it if even. Taking the node before instead leaves it.
+    if (queue_of(head)->reversed && !(queue_of(head)->size & 1))
+        mid = mid->prev;
+    else if (queue_of(head)->size == 1)
+        queue_of(head)->mid = NULL;
+    else
+        queue_of(head)->mid = queue_of(head)->size & 1 ? mid->next : mid->prev;
+    element_free(my_q_remove(head, mid, NULL, 0));
     return true;
 }
 
@@ -188,13 +701,18 @@ bool q_delete_dup(struct list_head *head)
     bool is_i_dup = false;
     if (!head)
         return false;
+    if (ops_of(head)) {
+        queue_of(head)->size -= ops_of(head)->delete_dup(head);
+        return true;
+    }
+    queue_of(head)->mid = NULL;
     i = head->next;
     for (j = i->next; j != head; j = j->next) {
-        if (strcmp(list_entry(i, element_t, list)->value,
-                   list_entry(j, element_t, list)->value) == 0) {
+        if (element_cmp(list_entry(i, element_t, list),
+                        list_entry(j, element_t, list)) == 0) {
             is_i_dup = true;
             // Remove j from the queue and release it
-            q_release_element(my_q_remove(j, NULL, 0));
+            element_free(my_q_remove(head, j, NULL, 0));
             // Assign i to j after j is deleted
             // For the next loop, j == i->next
             j = i;
@@ -202,13 +720,61 @@ bool q_delete_dup(struct list_head *head)
             i = i->next;
             // Delete the last node whose string was duplicated
             if (is_i_dup) {
-                q_release_element(my_q_remove(i->prev, NULL, 0));
+                element_free(my_q_remove(head, i->prev, NULL, 0));
                 is_i_dup = false;
             }
         }
     }
     if (is_i_dup)
-        q_release_element(my_q_remove(i, NULL, 0));
+        element_free(my_q_remove(head, i, NULL, 0));
+    return true;
+}
+
+/*
+ * Delete all nodes whose string occurs more than once in queue, sorted or
+ * not, keeping the others in their order.
+ * Strings are counted in a hash table sized from the queue length, which is
+ * allocated at once and freed before returning.
+ * Return true if successful.
+ * Return false if list is NULL or could not allocate space.
+ */
+bool q_delete_dup_hash(struct list_head *head)
+{
+    LIST_HEAD(dups);
+    struct dup_table table;
+    element_t *e, *safe;
+    size_t cap = 1;
+    int cnt = 0;
+    if (!head)
+        return false;
+    if (queue_of(head)->size < 2)
+        return true;
+    // Keep the table at most half full, so that probe sequences stay short
+    while (cap < 2 * (size_t) queue_of(head)->size)
+        cap <<= 1;
+    table.slots = malloc(cap * sizeof(struct dup_slot));
+    if (!table.slots)
+        return false;
+    memset(table.slots, 0, cap * sizeof(struct dup_slot));
+    table.mask = cap - 1;
+    // First pass counts the strings, second one takes out those seen twice.
+    // They are released only afterwards, as the table still points to some.
+    q_for_each(head, count_string, &table);
+    if (ops_of(head)) {
+        cnt = ops_of(head)->filter(head, is_unique, &table, &dups);
+    } else {
+        queue_of(head)->mid = NULL;
+        list_for_each_entry_safe (e, safe, head, list) {
+            if (!is_unique(e, &table)) {
+                list_move_tail(&e->list, &dups);
+                cnt++;
+            }
+        }
+    }
+    queue_of(head)->size -= cnt;
+    free(table.slots);
+    list_for_each_entry_safe (e, safe, &dups, list)
+        element_free(e);
     return true;
 }
 
@@ -218,7 +784,17 @@ bool q_delete_dup(struct list_head *head)
 void q_swap(struct list_head *head)
 {
     // https://leetcode.com/problems/swap-nodes-in-pairs/
-    if (!head || list_empty(head))
+    if (!head)
+        return;
+    // Pairs counted from either end are the same unless one element is left
+    if (queue_of(head)->size & 1)
+        q_materialize(head);
+    if (ops_of(head)) {
+        ops_of(head)->swap(head);
+        return;
+    }
+    queue_of(head)->mid = NULL;
+    if (list_empty(head))
         return;
     for (struct list_head *i = head->next; i != head && i->next != head;
          i = i->next)
@@ -234,7 +810,29 @@ void q_swap(struct list_head *head)
  */
 void q_reverse(struct list_head *head)
 {
-    if (!head || list_empty(head))
+    if (head)
+        queue_of(head)->reversed = !queue_of(head)->reversed;
+}
+
+/*
+ * Rearrange the elements left in reverse order by q_reverse(), so that the
+ * list of the list backend can be walked directly from head to tail, and
+ * forget the middle node, so that the list can be rearranged directly too.
+ * No effect if q is NULL.
+ */
+void q_materialize(struct list_head *head)
+{
+    if (!head)
+        return;
+    queue_of(head)->mid = NULL;
+    if (!queue_of(head)->reversed)
+        return;
+    queue_of(head)->reversed = false;
+    if (ops_of(head)) {
+        ops_of(head)->reverse(head);
+        return;
+    }
+    if (list_empty(head))
         return;
     for (struct list_head *i = head; i->next != head->prev; i = i->next)
         list_move(head->prev, i);
@@ -247,81 +845,549 @@ void q_reverse(struct list_head *head)
  */
 void q_sort(struct list_head *head)
 {
-    // Merge sort
-    struct list_head *i, *j, *tmp;
-    LIST_HEAD(new_head);
-    if (!head || list_empty(head) || list_is_singular(head))
+    if (!head)
+        return;
+    // Equal elements keep their order in the queue, not in the storage
+    q_materialize(head);
+    if (ops_of(head)) {
+        ops_of(head)->sort(head);
         return;
-    // Split the list
-    list_cut_position(&new_head, head, get_mid_node(head)->prev);
-    // Call recursively
-    q_sort(&new_head);
-    q_sort(head);
-    // Insert nodes in new_head to head
-    i = head->next;
-    for (j = new_head.next; !list_empty(&new_head); j = tmp) {
-        while (i != head && strcmp(list_entry(i, element_t, list)->value,
-                                   list_entry(j, element_t, list)->value) < 0) {
-            i = i->next;
-        }
-        if (i == head) {
-            // All of the remaining elements in new_head is greater than i
-            list_splice_tail_init(&new_head, i);
-        } else {
-            tmp = j->next;
-            list_del_init(j);
-            list_add_tail(j, i);
-            // i->prev == j
-        }
     }
+    if (list_empty(head) || list_is_singular(head))
+        return;
+    // Only the `next` links are kept up to date until the final pass
+    head->prev->next = NULL;
+    relink_chain(head, merge_sort(head->next));
 }
 
 /*
- * Create an element with string initialized.
- * Return NULL if could not allocate space or `s` is NULL.
+ * Sort elements of queue in ascending order, as q_sort, with a stable MSD
+ * radix sort, which distributes the elements on the leading bytes of their
+ * strings instead of comparing whole strings. It does not allocate.
+ * Other backends than the list sort with q_sort.
  */
-static element_t *alloc_helper(const char *s)
+void q_sort_radix(struct list_head *head)
 {
-    element_t *element;
-    size_t slen;
-    if (!s)
-        return NULL;
-    element = malloc(sizeof(element_t));
-    if (!element)
-        return NULL;
-
-    INIT_LIST_HEAD(&element->list);
-
-    slen = strlen(s) + 1;
-    element->value = malloc(slen);
-    if (!element->value) {
-        free(element);
-        return NULL;
+    struct list_head *list;
+    if (!head)
+        return;
+    q_materialize(head);
+    if (ops_of(head)) {
+        ops_of(head)->sort(head);
+        return;
     }
-    memcpy(element->value, s, slen);
-    return element;
+    if (list_empty(head) || list_is_singular(head))
+        return;
+    head->prev->next = NULL;
+    *radix_sort(head->next, queue_of(head)->size, 0, &list) = NULL;
+    relink_chain(head, list);
 }
 
 /*
- * Attempt to remove node from a queue.
- * Return target element.
- * Return NULL if queue is NULL or empty.
- * If sp is non-NULL and an element is removed, copy the removed string to *sp
- * (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ * Sort elements of queue in ascending order, as q_sort, by sorting an array
+ * of pointers to them, which stays in cache better than a long list, and
+ * relinking them in one pass. The sort is not stable.
+ * Argument scratch must have room for q_size() pointers, so that the sort
+ * does not allocate. Other backends than the list, or a NULL scratch, sort
+ * with q_sort.
  */
-static element_t *my_q_remove(struct list_head *node, char *sp, size_t bufsize)
+void q_sort_array(struct list_head *head, element_t **scratch)
 {
-    element_t *const element = list_entry(node, element_t, list);
-    list_del_init(node);
-    if (sp && bufsize) {
-        size_t min = strlen(element->value) + 1;
-        min = min > bufsize ? bufsize : min;
-        memcpy(sp, element->value, min);
-        sp[min - 1] = '\0';
-    }
+    struct list_head *node;
+    int n = 0;
+    if (!head)
+        return;
+    if (ops_of(head) || !scratch) {
+        q_sort(head);
+        return;
+    }
+    q_materialize(head);
+    list_for_each (node, head)
+        scratch[n++] = list_entry(node, element_t, list);
+    sort_elements(scratch, n);
+    node = head;
+    for (int i = 0; i < n; i++) {
+        node->next = &scratch[i]->list;
+        scratch[i]->list.prev = node;
+        node = node->next;
+    }
+    node->next = head;
+    head->prev = node;
+}
+
+/*
+ * Sort elements of queue in ascending order, as q_sort, by cutting it into
+ * `threads` parts of about the same size, sorting each on its own thread, and
+ * merging all the parts at once. The calling thread sorts one of the parts,
+ * and holds back signals until the queue is whole again, so that a signal
+ * handler never finds it in pieces.
+ * Other backends than the list, or fewer than 2 threads, sort with q_sort.
+ */
+void q_sort_parallel(struct list_head *head, int threads)
+{
+    struct sort_task tasks[SORT_THREADS_MAX];
+    struct list_head *chains[SORT_THREADS_MAX];
+    sigset_t all, old;
+    int size, left;
+    if (!head)
+        return;
+    if (ops_of(head) || threads < 2) {
+        q_sort(head);
+        return;
+    }
+    size = queue_of(head)->size;
+    if (size < 2)
+        return;
+    q_materialize(head);
+    if (threads > SORT_THREADS_MAX)
+        threads = SORT_THREADS_MAX;
+    if (threads > size)
+        threads = size;
+    // Cut the parts off the head of the queue, the last one being what is left
+    left = size;
+    for (int i = 0; i < threads - 1; i++) {
+        LIST_HEAD(part);
+        struct list_head *last = head;
+        for (int cnt = left / (threads - i); cnt > 0; cnt--)
+            last = last->next;
+        left -= left / (threads - i);
+        list_cut_position(&part, head, last);
+        part.prev->next = NULL;
+        tasks[i].chain = part.next;
+    }
+    head->prev->next = NULL;
+    tasks[threads - 1].chain = head->next;
+    INIT_LIST_HEAD(head);
+
+    // A signal handler jumping out of here would leave the queue in pieces and
+    // the threads running, so signals wait until the queue is whole again.
+    // The threads inherit the mask, leaving them all to the calling thread.
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (int i = 1; i < threads; i++) {
+        // Sort the part here if no thread can be spawned for it
+        if (pthread_create(&tasks[i].thread, NULL, sort_task_run, &tasks[i]))
+            tasks[i].thread = pthread_self();
+    }
+    tasks[0].chain = merge_sort(tasks[0].chain);
+    chains[0] = tasks[0].chain;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_equal(tasks[i].thread, pthread_self())) {
+            tasks[i].chain = merge_sort(tasks[i].chain);
+        } else {
+            pthread_join(tasks[i].thread, NULL);
+            cmp_stats.compares += tasks[i].stats.compares;
+            cmp_stats.by_key += tasks[i].stats.by_key;
+        }
+        chains[i] = tasks[i].chain;
+    }
+    merge_k_chains(head, chains, threads);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/*
+ * Select the backend of the queues created by q_new() from now on.
+ * Existing queues keep their own backend.
+ * Return false, with no effect, if backend is unknown.
+ */
+bool q_set_backend(queue_backend_t backend)
+{
+    if ((unsigned int) backend >=
+        sizeof(backend_ops) / sizeof(backend_ops[0]))
+        return false;
+    new_backend = backend;
+    return true;
+}
+
+/*
+ * Compare the strings of elements a and b as strcmp() does, through their
+ * cached keys as far as they tell.
+ */
+int q_compare(const element_t *a, const element_t *b)
+{
+    return element_cmp(a, b);
+}
+
+/*
+ * Report the comparisons made by the sorts, q_delete_dup and q_compare since
+ * the previous call, and reset the counters.
+ */
+void q_cmp_stats(cmp_stats_t *stats)
+{
+    *stats = cmp_stats;
+    cmp_stats.compares = cmp_stats.by_key = 0;
+}
+
+/*
+ * Report usage of the pool which elements are allocated from.
+ */
+void q_pool_stats(pool_stats_t *stats)
+{
+    *stats = element_pool.stats;
+}
+
+/*
+ * Select whether the elements created from now on come from the element
+ * pool, or are allocated one by one.
+ */
+void q_set_pool(bool pool)
+{
+    alloc_lock();
+    pool_set_direct(&element_pool, !pool);
+    alloc_unlock();
+}
+
+/*
+ * Select whether the elements created from now on share one interned copy of
+ * equal strings instead of holding their own.
+ */
+void q_set_intern(bool intern)
+{
+    intern_strings = intern;
+}
+
+/*
+ * Report usage of the table which strings are interned in.
+ */
+void q_intern_stats(intern_stats_t *stats)
+{
+    *stats = string_table.stats;
+}
+
+/*
+ * Let elements be created and released from several threads at once while
+ * more calls have passed true than false. Call with true before starting the
+ * threads, and with false once they are done and the elements they kept are
+ * handed back by element_trim().
+ */
+void q_set_threaded(bool threaded)
+{
+    // The harness locks its list of blocks over the same stretches
+    if (threaded && !atomic_fetch_add(&alloc_threaded, 1))
+        set_threaded_mode(true);
+    else if (!threaded && atomic_fetch_sub(&alloc_threaded, 1) == 1)
+        set_threaded_mode(false);
+}
+
+/*
+ * Create an element holding a copy of string s, as the q_insert_* functions
+ * do, without inserting it into any queue.
+ * Return NULL if could not allocate space or s is NULL.
+ */
+element_t *element_new(const char *s)
+{
+    element_t *element;
+    size_t slen;
+    if (!s)
+        return NULL;
+    slen = strlen(s) + 1;
+    // Elements holding their string need nothing but a slot, which the cache
+    // of the thread has without taking the lock
+    if (alloc_threaded && !element_pool.direct && element_cached(slen)) {
+        element = cache_get();
+        if (!element)
+            return NULL;
+        INIT_LIST_HEAD(&element->list);
+        element->value = element->inline_value;
+        memcpy(element->value, s, slen);
+        element->key = string_key(s, slen);
+        return element;
+    }
+    alloc_lock();
+    element = alloc_helper(s);
+    alloc_unlock();
+    return element;
+}
+
+/*
+ * Release element e created by element_new() or a q_insert_* function,
+ * returning it to the element pool and dropping its reference to an interned
+ * string.
+ */
+void element_free(element_t *e)
+{
+    bool is_inline = e->value == e->inline_value;
+#ifdef ELEMENT_PACKED
+    bool is_pooled =
+        sizeof(element_t) + strlen(e->value) + 1 <= ELEMENT_SLOT_SIZE;
+#else
+    bool is_pooled = true;
+#endif
+    if (alloc_threaded && !element_pool.direct && is_inline && is_pooled) {
+        cache_put(e);
+        return;
+    }
+    alloc_lock();
+    if (!is_inline && !intern_put(&string_table, e->value))
+        free(e->value);
+    if (is_pooled)
+        pool_free(&element_pool, e);
+    else
+        free(e);
+    alloc_unlock();
+}
+
+/*
+ * Hand the storage kept for elements back to the allocator if no element is
+ * left, as q_free() does.
+ */
+void element_trim(void)
+{
+    cache_flush(&element_cache);
+    alloc_lock();
+    pool_trim(&element_pool);
+    intern_trim(&string_table);
+    alloc_unlock();
+}
+
+/*
+ * Copy the string of element e to *sp, up to a maximum of bufsize - 1
+ * characters plus a null terminator, as the q_remove_* functions do.
+ * No effect if sp is NULL or bufsize is 0.
+ */
+void element_copy_string(const element_t *e, char *sp, size_t bufsize)
+{
+    size_t min;
+    if (!sp || !bufsize)
+        return;
+    min = strlen(e->value) + 1;
+    min = min > bufsize ? bufsize : min;
+    memcpy(sp, e->value, min);
+    sp[min - 1] = '\0';
+}
+
+/*
+ * Create an element with string initialized. The caller holds alloc_lock().
+ * Return NULL if could not allocate space or `s` is NULL.
+ */
+static element_t *alloc_helper(const char *s)
+{
+    element_t *element;
+    size_t slen, size;
+    bool is_inline;
+    if (!s)
+        return NULL;
+    slen = strlen(s) + 1;
+    is_inline = element_inline(slen);
+    /* Inline strings share the element's block and cost no extra allocation */
+    size = sizeof(element_t) + (is_inline ? slen : 0);
+    element = size <= ELEMENT_SLOT_SIZE ? pool_alloc(&element_pool)
+                                        : malloc(size);
+    if (!element)
+        return NULL;
+
+    INIT_LIST_HEAD(&element->list);
+
+    if (is_inline) {
+        element->value = element->inline_value;
+        memcpy(element->value, s, slen);
+    } else if (intern_strings) {
+        element->value = intern_get(&string_table, s, slen);
+        if (!element->value) {
+            pool_free(&element_pool, element);
+            return NULL;
+        }
+    } else {
+        element->value = malloc(slen);
+        if (!element->value) {
+            pool_free(&element_pool, element);
+            return NULL;
+        }
+        memcpy(element->value, s, slen);
+    }
+    element->key = string_key(s, slen);
     return element;
 }
 
+/*
+ * Return the first 8 bytes of string s of slen bytes, null terminator
+ * included, as a big-endian integer, zero padded.
+ */
+static uint64_t string_key(const char *s, size_t slen)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key <<= 8;
+        if (i < slen)
+            key |= (unsigned char) s[i];
+    }
+    return key;
+}
+
+/*
+ * Return the cache of the calling thread, making sure that it is handed back
+ * when the thread exits.
+ */
+static struct element_cache *thread_cache(void)
+{
+    struct element_cache *const c = &element_cache;
+    if (!c->registered) {
+        pthread_once(&cache_key_once, cache_key_create);
+        c->registered = !pthread_setspecific(cache_key, c);
+    }
+    return c;
+}
+
+/*
+ * Take an element from the cache of the calling thread, refilling it from the
+ * element pool if it is empty.
+ * Return NULL if could not allocate space.
+ */
+static element_t *cache_get(void)
+{
+    struct element_cache *const c = thread_cache();
+    element_t *e;
+    if (!c->cnt) {
+        alloc_lock();
+        while (c->cnt < ELEMENT_CACHE_BATCH) {
+            element_t *const slot = pool_alloc(&element_pool);
+            if (!slot)
+                break;
+            slot->list.next = c->free;
+            c->free = &slot->list;
+            c->cnt++;
+        }
+        alloc_unlock();
+        if (!c->cnt)
+            return NULL;
+    }
+    e = list_entry(c->free, element_t, list);
+    c->free = e->list.next;
+    c->cnt--;
+    return e;
+}
+
+/*
+ * Put pool element e into the cache of the calling thread, handing a batch
+ * back to the element pool once it holds two.
+ */
+static void cache_put(element_t *e)
+{
+    struct element_cache *const c = thread_cache();
+    e->list.next = c->free;
+    c->free = &e->list;
+    if (++c->cnt < 2 * ELEMENT_CACHE_BATCH)
+        return;
+    alloc_lock();
+    for (int i = 0; i < ELEMENT_CACHE_BATCH; i++) {
+        struct list_head *const node = c->free;
+        c->free = node->next;
+        pool_free(&element_pool, list_entry(node, element_t, list));
+    }
+    alloc_unlock();
+    c->cnt -= ELEMENT_CACHE_BATCH;
+}
+
+/*
+ * Hand all elements of `cache`, a struct element_cache, back to the element
+ * pool.
+ */
+static void cache_flush(void *cache)
+{
+    struct element_cache *const c = cache;
+    if (!c->cnt)
+        return;
+    alloc_lock();
+    while (c->free) {
+        struct list_head *const node = c->free;
+        c->free = node->next;
+        pool_free(&element_pool, list_entry(node, element_t, list));
+    }
+    alloc_unlock();
+    c->cnt = 0;
+}
+
+/*
+ * Create the key which hands the cache of each thread back when it exits.
+ */
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, cache_flush);
+}
+
+/*
+ * Create elements for strings s[0], ..., s[n - 1] and link them into `chain`,
+ * each one before the previous if `reverse` is true, after it otherwise.
+ * Stop at the first string that could not be allocated.
+ * Return number of elements created.
+ */
+static int alloc_chain(struct list_head *chain, char **s, int n, bool reverse)
+{
+    int i;
+    if (n <= 0)
+        return 0;
+    /* Grow the pool once for the whole batch. If that fails, allocate one
+     * by one and stop wherever the allocation fails.
+     */
+    alloc_lock();
+    pool_reserve(&element_pool, n);
+    for (i = 0; i < n; i++) {
+        element_t *const element = alloc_helper(s[i]);
+        if (!element)
+            break;
+        if (reverse)
+            list_add(&element->list, chain);
+        else
+            list_add_tail(&element->list, chain);
+    }
+    alloc_unlock();
+    return i;
+}
+
+/*
+ * Attempt to remove node from a queue.
+ * Return target element.
+ * Return NULL if queue is NULL or empty.
+ * If sp is non-NULL and an element is removed, copy the removed string to *sp
+ * (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ */
+static element_t *my_q_remove(struct list_head *head,
+                              struct list_head *node,
+                              char *sp,
+                              size_t bufsize)
+{
+    list_del_init(node);
+    return finish_remove(head, list_entry(node, element_t, list), sp, bufsize);
+}
+
+/*
+ * Account for element e having been unlinked from queue.
+ * Return e.
+ * If sp is non-NULL, copy the removed string to *sp as in my_q_remove.
+ */
+static element_t *finish_remove(struct list_head *head,
+                                element_t *e,
+                                char *sp,
+                                size_t bufsize)
+{
+    queue_of(head)->size--;
+    element_copy_string(e, sp, bufsize);
+    return e;
+}
+
+/*
+ * Copy the strings of the elements in `list` to *sp back to back, each with
+ * its null terminator, until they do not fit in bufsize bytes any more.
+ * The first string that does not fit is truncated to fill up the space left.
+ */
+static void copy_strings(const struct list_head *list,
+                         char *sp,
+                         size_t bufsize)
+{
+    element_t *i;
+    list_for_each_entry (i, list, list) {
+        size_t len = strlen(i->value) + 1;
+        if (len >= bufsize) {
+            memcpy(sp, i->value, bufsize - 1);
+            sp[bufsize - 1] = '\0';
+            return;
+        }
+        memcpy(sp, i->value, len);
+        sp += len;
+        bufsize -= len;
+    }
+}
+
 /*
  * Get the middle node in list.
  * The middle node of a linked list of size n is the
@@ -338,3 +1404,515 @@ static struct list_head *get_mid_node(const struct list_head *head)
         i = i->next, j = j->prev;
     return j;
 }
+
+/*
+ * Sort a NULL-terminated chain of elements linked through `list.next` in
+ * ascending order with a stable merge sort.
+ * Return the sorted chain.
+ */
+static struct list_head *merge_sort(struct list_head *list)
+{
+    // Natural merge sort after TimSort. Runs already in order are taken as
+    // they are, and the pending ones are merged as soon as their lengths stop
+    // decreasing fast enough, which keeps merges balanced and the stack short.
+    struct run runs[MERGE_PENDING_MAX];
+    int n = 0;
+    while (list) {
+        list = next_run(list, &runs[n++]);
+        while (n > 1) {
+            int i = n - 2;
+            if ((i > 0 && runs[i - 1].len <= runs[i].len + runs[i + 1].len) ||
+                (i > 1 && runs[i - 2].len <= runs[i - 1].len + runs[i].len)) {
+                if (runs[i - 1].len < runs[i + 1].len)
+                    i--;
+            } else if (runs[i].len > runs[i + 1].len) {
+                break;
+            }
+            merge_runs(&runs[i], &runs[i + 1]);
+            for (n--, i++; i < n; i++)
+                runs[i] = runs[i + 1];
+        }
+    }
+    for (; n > 1; n--)
+        merge_runs(&runs[n - 2], &runs[n - 1]);
+    return n ? runs[0].head : NULL;
+}
+
+/*
+ * Sort chain `list` of n elements, whose strings share their first `depth`
+ * bytes, by distributing them on the following bytes, and link the sorted
+ * chain at *tail.
+ * Return the link field of the last element of the sorted chain.
+ */
+static struct list_head **radix_sort(struct list_head *list,
+                                     int n,
+                                     size_t depth,
+                                     struct list_head **tail)
+{
+    // Buckets of the elements by their byte at `depth`
+    struct list_head *heads[256], **tails[256];
+    int counts[256] = {0};
+    unsigned char lo = UCHAR_MAX, hi = 0;
+    if (n <= RADIX_INSERTION_MAX) {
+        // Insert each element after the ones not greater, keeping it stable
+        *tail = NULL;
+        while (list) {
+            struct list_head *node = list, **pos = tail;
+            list = list->next;
+            while (*pos && strcmp(list_entry(*pos, element_t, list)->value +
+                                      depth,
+                                  list_entry(node, element_t, list)->value +
+                                      depth) <= 0)
+                pos = &(*pos)->next;
+            node->next = *pos;
+            *pos = node;
+        }
+        while (*tail)
+            tail = &(*tail)->next;
+        return tail;
+    }
+    if (depth >= RADIX_MAX_DEPTH) {
+        // Bound the recursion, and the stack it takes, on long common prefixes
+        *tail = merge_sort(list);
+        while (*tail)
+            tail = &(*tail)->next;
+        return tail;
+    }
+    for (; list; list = list->next) {
+        unsigned char c = list_entry(list, element_t, list)->value[depth];
+        if (!counts[c]++)
+            tails[c] = &heads[c];
+        *tails[c] = list;
+        tails[c] = &list->next;
+        lo = c < lo ? c : lo;
+        hi = c > hi ? c : hi;
+    }
+    for (int c = lo; c <= hi; c++) {
+        if (!counts[c])
+            continue;
+        *tails[c] = NULL;
+        if (c == 0) {
+            // Strings ending here are all equal and already in order
+            *tail = heads[0];
+            tail = tails[0];
+        } else {
+            tail = radix_sort(heads[c], counts[c], depth + 1, tail);
+        }
+    }
+    return tail;
+}
+
+/*
+ * Link the elements of NULL-terminated chain `list` into list `head`, in
+ * chain order, setting their `prev` links on the way.
+ */
+static void relink_chain(struct list_head *head, struct list_head *list)
+{
+    struct list_head *prev = head;
+    for (; list; list = list->next) {
+        list->prev = prev;
+        prev->next = list;
+        prev = list;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+/*
+ * Merge two sorted NULL-terminated chains of elements linked through
+ * `list.next`. Elements of `a` go first among equal ones.
+ * Return the merged chain.
+ */
+struct list_head *merge_chains(struct list_head *a, struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+    while (a && b) {
+        if (element_cmp(list_entry(a, element_t, list),
+                        list_entry(b, element_t, list)) <= 0) {
+            *tail = a;
+            a = a->next;
+        } else {
+            *tail = b;
+            b = b->next;
+        }
+        tail = &(*tail)->next;
+    }
+    *tail = a ? a : b;
+    return head;
+}
+
+/*
+ * Thread body of q_sort_parallel(): sort the chain of struct sort_task `arg`.
+ */
+static void *sort_task_run(void *arg)
+{
+    struct sort_task *const task = arg;
+    task->chain = merge_sort(task->chain);
+    task->stats = cmp_stats;
+    return NULL;
+}
+
+/*
+ * Restore the heap order of chain indices heap[0], ..., heap[n - 1] from
+ * position `pos` down, after the front of chain heap[pos] has changed.
+ */
+static void sift_chains(struct list_head **chains, int *heap, int n, int pos)
+{
+    for (int child; (child = 2 * pos + 1) < n; pos = child) {
+        if (child + 1 < n && chain_before(chains, heap[child + 1], heap[child]))
+            child++;
+        if (!chain_before(chains, heap[child], heap[pos]))
+            break;
+        int tmp = heap[pos];
+        heap[pos] = heap[child];
+        heap[child] = tmp;
+    }
+}
+
+/*
+ * Merge k sorted NULL-terminated chains into empty list `head`, taking the
+ * least of the elements at the front of all chains at each step, through a
+ * heap of the chains. Elements of chains[i] go before those of chains[j]
+ * among equal ones if i < j.
+ */
+static void merge_k_chains(struct list_head *head,
+                           struct list_head **chains,
+                           int k)
+{
+    int heap[SORT_THREADS_MAX], n = 0;
+    struct list_head *tail = head;
+    for (int i = 0; i < k; i++) {
+        if (chains[i])
+            heap[n++] = i;
+    }
+    for (int i = n / 2; i-- > 0;)
+        sift_chains(chains, heap, n, i);
+    while (n > 1) {
+        const int i = heap[0];
+        struct list_head *const node = chains[i];
+        tail->next = node;
+        node->prev = tail;
+        tail = node;
+        chains[i] = node->next;
+        if (!chains[i])
+            heap[0] = heap[--n];
+        sift_chains(chains, heap, n, 0);
+    }
+    // The last chain left follows as it is
+    for (struct list_head *node = n ? chains[heap[0]] : NULL; node;
+         node = node->next) {
+        tail->next = node;
+        node->prev = tail;
+        tail = node;
+    }
+    tail->next = head;
+    head->prev = tail;
+}
+
+/*
+ * Take the run at the front of chain `list` into *run, reversing it if it is
+ * strictly descending, and extend it to MIN_RUN elements if shorter by
+ * inserting the following ones.
+ * Return the rest of the chain.
+ */
+static struct list_head *next_run(struct list_head *list, struct run *run)
+{
+    struct list_head *head = list, *tail = list;
+    int len = 1;
+    list = list->next;
+    head->prev = NULL;
+    if (list && element_cmp(list_entry(list, element_t, list),
+                            list_entry(head, element_t, list)) < 0) {
+        // Strictly descending, so that reversing it keeps the sort stable
+        do {
+            struct list_head *const node = list;
+            list = list->next;
+            node->next = head;
+            head->prev = node;
+            head = node;
+            len++;
+        } while (list && element_cmp(list_entry(list, element_t, list),
+                                     list_entry(head, element_t, list)) < 0);
+        head->prev = NULL;
+    } else {
+        while (list && element_cmp(list_entry(list, element_t, list),
+                                   list_entry(tail, element_t, list)) >= 0) {
+            list->prev = tail;
+            tail = list;
+            list = list->next;
+            len++;
+        }
+    }
+    // Insert each element after the last one not greater, searching from the
+    // tail through the `prev` links, which makes nearly sorted input cheap
+    for (; len < MIN_RUN && list; len++) {
+        struct list_head *const node = list, *pos = tail;
+        list = list->next;
+        while (pos && element_cmp(list_entry(pos, element_t, list),
+                                  list_entry(node, element_t, list)) > 0)
+            pos = pos->prev;
+        node->prev = pos;
+        if (!pos) {
+            node->next = head;
+            head->prev = node;
+            head = node;
+        } else if (pos == tail) {
+            tail->next = node;
+            tail = node;
+        } else {
+            node->next = pos->next;
+            pos->next->prev = node;
+            pos->next = node;
+        }
+    }
+    tail->next = NULL;
+    run->head = head;
+    run->tail = tail;
+    run->len = len;
+    return list;
+}
+
+/*
+ * Return the last node of the stretch of chain `node` whose elements go before
+ * element `key`, those less than it, or also equal to it if `with_equal` is
+ * true. Node `node` itself must go before it.
+ */
+static struct list_head *gallop(struct list_head *node,
+                                const element_t *key,
+                                bool with_equal)
+{
+    int step = 1, dist;
+    // Probe 1, 2, 4, ... nodes ahead until one does not go before the key,
+    // or the chain ends, at `dist` nodes from the last one which did
+    for (;;) {
+        struct list_head *probe = node;
+        for (dist = 0; dist < step && probe->next; dist++)
+            probe = probe->next;
+        if (dist < step) {
+            dist++;
+            break;
+        }
+        if (!goes_before(probe, key, with_equal))
+            break;
+        node = probe;
+        step *= 2;
+    }
+    // Binary search between them, walking from the last node found to go
+    // before the key each time
+    while (dist > 1) {
+        struct list_head *mid = node;
+        for (int i = 0; i < dist / 2; i++)
+            mid = mid->next;
+        if (goes_before(mid, key, with_equal)) {
+            node = mid;
+            dist -= dist / 2;
+        } else {
+            dist /= 2;
+        }
+    }
+    return node;
+}
+
+/*
+ * Merge run b into run a which precedes it, keeping the elements of `a` first
+ * among equal ones. Runs already in order are joined at once, and once one
+ * run wins MIN_GALLOP times in a row, the stretch of its elements which goes
+ * before the other run's front is found with gallop() and moved as a whole.
+ */
+static void merge_runs(struct run *a, struct run *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+    struct list_head *x = a->head, *y = b->head;
+    int wins_x = 0, wins_y = 0;
+    a->len += b->len;
+    if (!goes_before(y, list_entry(a->tail, element_t, list), false)) {
+        a->tail->next = b->head;
+        a->tail = b->tail;
+        return;
+    }
+    if (goes_before(b->tail, list_entry(x, element_t, list), false)) {
+        b->tail->next = a->head;
+        a->head = b->head;
+        return;
+    }
+    while (x && y) {
+        struct list_head *last;
+        if (goes_before(y, list_entry(x, element_t, list), false)) {
+            last = ++wins_y < MIN_GALLOP
+                       ? y
+                       : gallop(y, list_entry(x, element_t, list), false);
+            *tail = y;
+            y = last->next;
+            wins_x = 0;
+        } else {
+            last = ++wins_x < MIN_GALLOP
+                       ? x
+                       : gallop(x, list_entry(y, element_t, list), true);
+            *tail = x;
+            x = last->next;
+            wins_y = 0;
+        }
+        tail = &last->next;
+    }
+    *tail = x ? x : y;
+    a->head = head;
+    if (!x)
+        a->tail = b->tail;
+}
+
+/*
+ * Return the slot of table t holding the string of element e, or the free
+ * slot where it would go.
+ */
+static struct dup_slot *dup_slot_of(struct dup_table *t, element_t *e)
+{
+    // 32-bit FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char *c = e->value; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    for (size_t i = hash;; i++) {
+        struct dup_slot *const slot = &t->slots[i & t->mask];
+        if (!slot->e) {
+            slot->hash = hash;
+            return slot;
+        }
+        if (slot->hash == hash && element_cmp(slot->e, e) == 0)
+            return slot;
+    }
+}
+
+/*
+ * Count the string of element e in struct dup_table `priv`, as a q_visit_t.
+ */
+static bool count_string(element_t *e, void *priv)
+{
+    struct dup_slot *const slot = dup_slot_of(priv, e);
+    if (!slot->e)
+        slot->e = e;
+    slot->cnt++;
+    return true;
+}
+
+/*
+ * Return whether the string of element e is counted once in struct dup_table
+ * `priv`, as a q_visit_t.
+ */
+static bool is_unique(element_t *e, void *priv)
+{
+    return dup_slot_of(priv, e)->cnt == 1;
+}
+
+/*
+ * Insert an element for string s at the head of the storage of the queue if
+ * `at_head` is true, at its tail otherwise.
+ * Return false if could not allocate space.
+ */
+static bool insert_at(struct list_head *head, char *s, bool at_head)
+{
+    element_t *const element = element_new(s);
+    if (!element)
+        return false;
+    if (!ops_of(head)) {
+        queue_t *const q = queue_of(head);
+        if (at_head)
+            list_add(&element->list, head);
+        else
+            list_add_tail(&element->list, head);
+        // Node ⌊size / 2⌋ shifts back by one when inserting at head onto an
+        // even count, forward when inserting at tail onto an odd one
+        if (!q->size)
+            q->mid = &element->list;
+        else if (q->mid && at_head && !(q->size & 1))
+            q->mid = q->mid->prev;
+        else if (q->mid && !at_head && (q->size & 1))
+            q->mid = q->mid->next;
+    } else if (!(at_head ? ops_of(head)->insert_head(head, element)
+                         : ops_of(head)->insert_tail(head, element))) {
+        element_free(element);
+        return false;
+    }
+    queue_of(head)->size++;
+    return true;
+}
+
+/*
+ * Insert elements for strings s[0], ..., s[n - 1] in turn at the head of the
+ * storage of the queue if `at_head` is true, at its tail otherwise.
+ * Return number of strings inserted.
+ */
+static int insert_bulk_at(struct list_head *head,
+                          char **s,
+                          int n,
+                          bool at_head)
+{
+    LIST_HEAD(chain);
+    queue_t *const q = queue_of(head);
+    int cnt = 0, old_mid, new_mid;
+    if (ops_of(head)) {
+        // Other backends store the elements one by one anyway
+        while (cnt < n && insert_at(head, s[cnt], at_head))
+            cnt++;
+        return cnt;
+    }
+    cnt = alloc_chain(&chain, s, n, at_head);
+    if (at_head)
+        list_splice(&chain, head);
+    else
+        list_splice_tail(&chain, head);
+    // Node ⌊size / 2⌋ moves from index old_mid to new_mid. Inserting at head
+    // shifts the old one forward by cnt, which takes it past the new one.
+    old_mid = q->size / 2;
+    new_mid = (q->size + cnt) / 2;
+    if (!q->size && cnt) {
+        q->mid = head->next;
+        for (int i = 0; i < new_mid; i++)
+            q->mid = q->mid->next;
+    } else if (q->mid && at_head) {
+        for (int i = new_mid; i < old_mid + cnt; i++)
+            q->mid = q->mid->prev;
+    } else if (q->mid) {
+        for (int i = old_mid; i < new_mid; i++)
+            q->mid = q->mid->next;
+    }
+    q->size += cnt;
+    return cnt;
+}
+
+/*
+ * Remove the element at the head of the storage of a non-empty queue if
+ * `at_head` is true, at its tail otherwise.
+ * Return the element, whose string is copied to *sp as in my_q_remove.
+ */
+static element_t *remove_at(struct list_head *head,
+                            bool at_head,
+                            char *sp,
+                            size_t bufsize)
+{
+    if (ops_of(head))
+        return finish_remove(head,
+                             at_head ? ops_of(head)->remove_head(head)
+                                     : ops_of(head)->remove_tail(head),
+                             sp, bufsize);
+    // Node ⌊size / 2⌋ shifts forward by one when removing at head from an odd
+    // count, back when removing at tail from an even one
+    if (queue_of(head)->size == 1)
+        queue_of(head)->mid = NULL;
+    else if (queue_of(head)->mid && at_head && (queue_of(head)->size & 1))
+        queue_of(head)->mid = queue_of(head)->mid->next;
+    else if (queue_of(head)->mid && !at_head && !(queue_of(head)->size & 1))
+        queue_of(head)->mid = queue_of(head)->mid->prev;
+    return my_q_remove(head, at_head ? head->next : head->prev, sp, bufsize);
+}
+
+/*
+ * Return the element at the head of the storage of a non-empty queue if
+ * `at_head` is true, at its tail otherwise.
+ */
+static element_t *peek_at(struct list_head *head, bool at_head)
+{
+    if (ops_of(head))
+        return at_head ? ops_of(head)->peek_head(head)
+                       : ops_of(head)->peek_tail(head);
+    return at_head ? list_first_entry(head, element_t, list)
+                   : list_last_entry(head, element_t, list);
+}
@@ -5,22 +5,93 @@
  * This program implements a queue supporting both FIFO and LIFO
  * operations.
  *
- * It uses a circular doubly-linked list to represent the set of queue elements
+ * By default it uses a circular doubly-linked list to represent the set of
+ * queue elements. Other storage backends can be selected at build time, or
+ * at run time through q_set_backend().
  */
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
 #include "list.h"
+#include "pool.h"
+
+/*
+ * Strings of up to this many bytes, including the null terminator, are stored
+ * inside the element itself instead of in a separate allocation.
+ * When built with ELEMENT_PACKED, every string is stored inside its element,
+ * whatever its length.
+ */
+#define ELEMENT_INLINE_SIZE 16
 
 /* Linked list element */
 typedef struct {
     /* Pointer to array holding string.
-     * This array needs to be explicitly allocated and freed
+     * Inline strings point to `inline_value` below; longer ones point to an
+     * array which needs to be explicitly allocated and freed, or to a string
+     * interned by q_set_intern(), which must not be modified
      */
     char *value;
     struct list_head list;
+    /* First 8 bytes of the string as a big-endian integer, zero padded, so
+     * that most comparisons need not read the string itself
+     */
+    uint64_t key;
+    /* Inline string, allocated in the same block as the element */
+    char inline_value[];
 } element_t;
 
+/* Storage backends of queue */
+typedef enum {
+    /* Circular doubly-linked list of the elements, linked through `list` */
+    QUEUE_LIST,
+    /* Unrolled list: linked blocks, each holding pointers to many elements */
+    QUEUE_UNROLLED,
+    /* Ring buffer of element pointers, doubling its capacity when full */
+    QUEUE_RING,
+} queue_backend_t;
+
+/* Backend of new queues unless changed by q_set_backend() */
+#ifndef QUEUE_BACKEND
+#define QUEUE_BACKEND QUEUE_LIST
+#endif
+
+/* Queue header
+ * The list head handed out by q_new() is embedded in this structure, so every
+ * q_* function can reach the metadata below in constant time. Field `head`
+ * must stay the first member.
+ * Only the QUEUE_LIST backend links the elements into `head`; others use it
+ * for their own storage, so the elements must then be reached through the q_*
+ * functions, such as q_for_each().
+ */
+typedef struct {
+    struct list_head head;
+    /* Number of elements, kept up to date by every q_* function */
+    int size;
+    /* How the elements are stored */
+    queue_backend_t backend;
+    /* Whether the queue runs from the tail of the storage to its head, as
+     * left by q_reverse(), which only flips this
+     */
+    bool reversed;
+    /* Node ⌊size / 2⌋ of the list backend, counted from the head of the list.
+     * Inserting or removing at either end and q_delete_mid() move it along,
+     * with the parity of `size` telling which way. Other operations reset it
+     * to NULL, for the next q_delete_mid() to find it again.
+     */
+    struct list_head *mid;
+} queue_t;
+
+/* Counters of the comparisons between elements */
+typedef struct {
+    size_t compares; /* Comparisons made */
+    size_t by_key;   /* Comparisons decided by the cached keys alone */
+} cmp_stats_t;
+
+/* Callback of q_for_each(). Return false to stop the walk */
+typedef bool (*q_visit_t)(element_t *e, void *priv);
+
 /* Operations on queue */
 
 /*
@@ -53,6 +124,22 @@ bool q_insert_head(struct list_head *head, char *s);
  */
 bool q_insert_tail(struct list_head *head, char *s);
 
+/*
+ * Attempt to insert n elements at head of queue, with the same effect as
+ * calling q_insert_head() for s[0], s[1], ..., s[n - 1] in turn.
+ * The elements are allocated in one batch and linked into the queue at once.
+ * Return number of strings inserted, which is less than n if q is NULL or
+ * space could not be allocated for the string following the inserted ones.
+ */
+int q_insert_head_bulk(struct list_head *head, char **s, int n);
+
+/*
+ * Attempt to insert n elements at tail of queue, with the same effect as
+ * calling q_insert_tail() for s[0], s[1], ..., s[n - 1] in turn.
+ * Other attribute is as same as q_insert_head_bulk.
+ */
+int q_insert_tail_bulk(struct list_head *head, char **s, int n);
+
 /*
  * Attempt to remove element from head of queue.
  * Return target element.
@@ -75,13 +162,51 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize);
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
 
+/*
+ * Attempt to remove up to n elements from head of queue in one operation.
+ * The removed elements are moved, in queue order, to the tail of list `out`.
+ * If sp is non-NULL, the removed strings are also copied to *sp back to back,
+ * each with its null terminator, as long as they fit in bufsize bytes. The
+ * first string that does not fit is truncated as in q_remove_head, and the
+ * ones following it are not copied.
+ * Return number of elements removed.
+ * Return 0 if queue is NULL or empty, or out is NULL.
+ *
+ * NOTE: as in q_remove_head, the removed elements are unlinked, not freed.
+ */
+int q_remove_head_n(struct list_head *head,
+                    struct list_head *out,
+                    int n,
+                    char *sp,
+                    size_t bufsize);
+
 /*
  * Attempt to release element.
  */
 void q_release_element(element_t *e);
 
 /*
- * Return number of elements in queue.
+ * Return element at head of queue without removing it.
+ * Return NULL if queue is NULL or empty.
+ */
+element_t *q_peek_head(struct list_head *head);
+
+/*
+ * Return element at tail of queue without removing it.
+ * Return NULL if queue is NULL or empty.
+ */
+element_t *q_peek_tail(struct list_head *head);
+
+/*
+ * Call visit(e, priv) for each element e from head to tail of queue, until it
+ * returns false. The elements must not be removed during the walk.
+ * Return number of elements visited.
+ * Return 0 if queue is NULL or empty.
+ */
+int q_for_each(struct list_head *head, q_visit_t visit, void *priv);
+
+/*
+ * Return number of elements in queue in constant time.
  * Return 0 if q is NULL or empty
  */
 int q_size(struct list_head *head);
@@ -108,6 +233,16 @@ bool q_delete_mid(struct list_head *head);
  */
 bool q_delete_dup(struct list_head *head);
 
+/*
+ * Delete all nodes whose string occurs more than once in queue, sorted or
+ * not, keeping the others in their order.
+ * Strings are counted in a hash table sized from the queue length, which is
+ * allocated at once and freed before returning.
+ * Return true if successful.
+ * Return false if list is NULL or could not allocate space.
+ */
+bool q_delete_dup_hash(struct list_head *head);
+
 /*
  * Attempt to swap every two adjacent nodes.
  *
@@ -121,9 +256,20 @@ void q_swap(struct list_head *head);
  * This function should not allocate or free any list elements
  * (e.g., by calling q_insert_head, q_insert_tail, or q_remove_head).
  * It should rearrange the existing ones.
+ * Only the orientation of the queue is flipped, in constant time. The other
+ * q_* functions take it into account, and rearrange the elements when they
+ * need them in queue order.
  */
 void q_reverse(struct list_head *head);
 
+/*
+ * Rearrange the elements left in reverse order by q_reverse(), so that the
+ * list of the list backend can be walked directly from head to tail, and
+ * forget the middle node, so that the list can be rearranged directly too.
+ * No effect if q is NULL.
+ */
+void q_materialize(struct list_head *head);
+
 /*
  * Sort elements of queue in ascending order
  * No effect if q is NULL or empty. In addition, if q has only one
@@ -131,4 +277,95 @@ void q_reverse(struct list_head *head);
  */
 void q_sort(struct list_head *head);
 
+/*
+ * Sort elements of queue in ascending order, as q_sort, with a stable MSD
+ * radix sort, which distributes the elements on the leading bytes of their
+ * strings instead of comparing whole strings. It does not allocate.
+ * Other backends than the list sort with q_sort.
+ */
+void q_sort_radix(struct list_head *head);
+
+/*
+ * Sort elements of queue in ascending order, as q_sort, by sorting an array
+ * of pointers to them, which stays in cache better than a long list, and
+ * relinking them in one pass. The sort is not stable.
+ * Argument scratch must have room for q_size() pointers, so that the sort
+ * does not allocate. Other backends than the list, or a NULL scratch, sort
+ * with q_sort.
+ */
+void q_sort_array(struct list_head *head, element_t **scratch);
+
+/* Most threads q_sort_parallel() sorts with */
+#define SORT_THREADS_MAX 64
+
+/*
+ * Sort elements of queue in ascending order, as q_sort, by cutting it into
+ * `threads` parts of about the same size, sorting each on its own thread, and
+ * merging all the parts at once. The calling thread sorts one of the parts,
+ * and holds back signals until the queue is whole again, so that a signal
+ * handler never finds it in pieces.
+ * Other backends than the list, or fewer than 2 threads, sort with q_sort.
+ */
+void q_sort_parallel(struct list_head *head, int threads);
+
+/*
+ * Select the backend of the queues created by q_new() from now on.
+ * Existing queues keep their own backend.
+ * Return false, with no effect, if backend is unknown.
+ */
+bool q_set_backend(queue_backend_t backend);
+
+/*
+ * Compare the strings of elements a and b as strcmp() does, through their
+ * cached keys as far as they tell.
+ */
+int q_compare(const element_t *a, const element_t *b);
+
+/*
+ * Report the comparisons made by the sorts, q_delete_dup and q_compare since
+ * the previous call on the calling thread, and reset the counters. Those of
+ * the threads of q_sort_parallel() count as the caller's.
+ */
+void q_cmp_stats(cmp_stats_t *stats);
+
+/*
+ * Report usage of the pool which elements are allocated from.
+ */
+void q_pool_stats(pool_stats_t *stats);
+
+/*
+ * Select whether the elements created from now on come from the element
+ * pool, or are allocated one by one, so that the harness checks each of them
+ * and fails allocations per element rather than per chunk.
+ */
+void q_set_pool(bool pool);
+
+/*
+ * Select whether the elements created from now on share one interned copy of
+ * equal strings instead of holding their own. Inline strings are never
+ * interned, as they cost no allocation of their own.
+ * Interned strings are released with their last element, whatever the
+ * selection by then.
+ */
+void q_set_intern(bool intern);
+
+/*
+ * Report usage of the table which strings are interned in.
+ */
+void q_intern_stats(intern_stats_t *stats);
+
+/*
+ * Let elements be created and released from several threads at once while
+ * more calls have passed true than false. Call with true before starting the
+ * threads, and with false once they are done and the elements they kept are
+ * handed back by element_trim(). The concurrent queues built on element_t
+ * make the first call when created and the second when freed. Each queue of
+ * this file must still be used by one thread at a time.
+ * Meanwhile each thread keeps a cache of pool elements, so that elements with
+ * inline strings only take a lock once per batch, and hands it back when it
+ * exits or calls a function freeing a queue. Other elements take it each
+ * time. Otherwise, element allocation takes no lock.
+ */
+void q_set_threaded(bool threaded);
+
 #endif /* LAB0_QUEUE_H */
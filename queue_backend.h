@@ -0,0 +1,133 @@
+#ifndef LAB0_QUEUE_BACKEND_H
+#define LAB0_QUEUE_BACKEND_H
+
+/*
+ * Storage backends of queue other than the plain list, and helpers shared
+ * with the concurrent queues built on element_t.
+ *
+ * queue.c allocates and releases the elements, keeps the element count of the
+ * queue header and copies the strings of removed elements. A backend only
+ * arranges element pointers in its own structures, rooted at the `head` of
+ * the queue header, and is never called with a NULL queue.
+ */
+
+#include <string.h>
+
+#include "queue.h"
+
+/* Get the queue header embedding list head `h` */
+#define queue_of(h) list_entry(h, queue_t, head)
+
+/* Size of the cache lines the concurrent queues keep apart to avoid false
+ * sharing
+ */
+#define CACHE_LINE 64
+
+struct queue_ops {
+    /* Set up storage of an empty queue. Return false if could not allocate */
+    bool (*init)(struct list_head *head);
+    /* Release all elements and storage, except for the queue header */
+    void (*free)(struct list_head *head);
+    /* Store element e at head. Return false if could not allocate space */
+    bool (*insert_head)(struct list_head *head, element_t *e);
+    /* Store element e at tail. Return false if could not allocate space */
+    bool (*insert_tail)(struct list_head *head, element_t *e);
+    /* Unlink and return element at head. Queue must not be empty */
+    element_t *(*remove_head)(struct list_head *head);
+    /* Unlink and return element at tail. Queue must not be empty */
+    element_t *(*remove_tail)(struct list_head *head);
+    /* Unlink and return the middle element. Queue must not be empty */
+    element_t *(*remove_mid)(struct list_head *head);
+    /* Return element at head. Queue must not be empty */
+    element_t *(*peek_head)(struct list_head *head);
+    /* Return element at tail. Queue must not be empty */
+    element_t *(*peek_tail)(struct list_head *head);
+    /* As q_for_each(), but from tail to head if reversed */
+    int (*for_each)(struct list_head *head,
+                    bool reversed,
+                    q_visit_t visit,
+                    void *priv);
+    /* Release duplicates of a sorted queue. Return number of them released */
+    int (*delete_dup)(struct list_head *head);
+    /* Move the elements for which keep(e, priv) returns false to the tail of
+     * list `out`, keeping the order of the others. Return number of them moved
+     */
+    int (*filter)(struct list_head *head,
+                  q_visit_t keep,
+                  void *priv,
+                  struct list_head *out);
+    /* As q_swap(), q_reverse() and q_sort() */
+    void (*swap)(struct list_head *head);
+    void (*reverse)(struct list_head *head);
+    void (*sort)(struct list_head *head);
+};
+
+/* Counters of element_cmp(), one set per thread */
+extern _Thread_local cmp_stats_t cmp_stats;
+
+/*
+ * Compare the strings of elements a and b as strcmp() does. The cached keys
+ * decide unless they are equal and hold no null terminator, in which case
+ * only the bytes after them are left to compare, unless both elements share
+ * one interned string.
+ */
+static inline int element_cmp(const element_t *a, const element_t *b)
+{
+    cmp_stats.compares++;
+    if (a->key != b->key) {
+        cmp_stats.by_key++;
+        return a->key < b->key ? -1 : 1;
+    }
+    if (!(a->key & 0xff)) {
+        cmp_stats.by_key++;
+        return 0;
+    }
+    if (a->value == b->value)
+        return 0;
+    return strcmp(a->value + sizeof(a->key), b->value + sizeof(b->key));
+}
+
+/*
+ * Merge two sorted NULL-terminated chains of elements linked through
+ * `list.next`. Elements of `a` go first among equal ones.
+ * Return the merged chain.
+ */
+struct list_head *merge_chains(struct list_head *a, struct list_head *b);
+
+/*
+ * Sort element pointers a[0], ..., a[n - 1] in ascending order of their
+ * strings, in place. The sort is not stable.
+ */
+void sort_elements(element_t **a, size_t n);
+
+/*
+ * Create an element holding a copy of string s, as the q_insert_* functions
+ * do, without inserting it into any queue.
+ * Return NULL if could not allocate space or s is NULL.
+ */
+element_t *element_new(const char *s);
+
+/*
+ * Release element e created by element_new() or a q_insert_* function,
+ * returning it to the element pool and dropping its reference to an interned
+ * string. q_release_element() is the same for code outside the queue.
+ */
+void element_free(element_t *e);
+
+/*
+ * Hand the storage kept for elements back to the allocator if no element is
+ * left, as q_free() does.
+ */
+void element_trim(void);
+
+/*
+ * Copy the string of element e to *sp, up to a maximum of bufsize - 1
+ * characters plus a null terminator, as the q_remove_* functions do.
+ * No effect if sp is NULL or bufsize is 0.
+ */
+void element_copy_string(const element_t *e, char *sp, size_t bufsize);
+
+extern const struct queue_ops unrolled_ops;
+extern const struct queue_ops ring_ops;
+
+#endif /* LAB0_QUEUE_BACKEND_H */
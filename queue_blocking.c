@@ -0,0 +1,141 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_blocking.h"
+
+struct bk_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+    struct list_head head;
+    int size;
+    int waiters; /* Consumers waiting on `nonempty` */
+    int efd;     /* Counter of 1 while not empty, or -1 until bkq_fd() */
+};
+
+bk_queue_t *bkq_new(void)
+{
+    bk_queue_t *const q = malloc(sizeof(bk_queue_t));
+    pthread_condattr_t attr;
+    if (!q)
+        return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    // Timeouts are not to move with the wall clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->nonempty, &attr);
+    pthread_condattr_destroy(&attr);
+    INIT_LIST_HEAD(&q->head);
+    q->size = 0;
+    q->waiters = 0;
+    q->efd = -1;
+    q_set_threaded(true);
+    return q;
+}
+
+void bkq_free(bk_queue_t *q)
+{
+    element_t *e, *tmp;
+    if (!q)
+        return;
+    list_for_each_entry_safe (e, tmp, &q->head, list)
+        element_free(e);
+    if (q->efd >= 0)
+        close(q->efd);
+    pthread_cond_destroy(&q->nonempty);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+    element_trim();
+    q_set_threaded(false);
+}
+
+bool bkq_insert_tail(bk_queue_t *q, char *s)
+{
+    element_t *const e = element_new(s);
+    if (!e)
+        return false;
+    bkq_enqueue(q, e);
+    return true;
+}
+
+element_t *bkq_remove_head(bk_queue_t *q,
+                           char *sp,
+                           size_t bufsize,
+                           int timeout_ms)
+{
+    element_t *const e = bkq_dequeue(q, timeout_ms);
+    if (e)
+        element_copy_string(e, sp, bufsize);
+    return e;
+}
+
+void bkq_enqueue(bk_queue_t *q, element_t *e)
+{
+    pthread_mutex_lock(&q->lock);
+    list_add_tail(&e->list, &q->head);
+    if (!q->size++ && q->efd >= 0) {
+        const uint64_t one = 1;
+        // Cannot fail: the counter is 0 until now
+        if (write(q->efd, &one, sizeof(one)) < 0)
+            abort();
+    }
+    if (q->waiters)
+        pthread_cond_signal(&q->nonempty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+element_t *bkq_dequeue(bk_queue_t *q, int timeout_ms)
+{
+    struct timespec deadline;
+    element_t *e = NULL;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += timeout_ms % 1000 * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_mutex_lock(&q->lock);
+    while (list_empty(&q->head) && timeout_ms) {
+        int err;
+        q->waiters++;
+        err = timeout_ms < 0
+                  ? pthread_cond_wait(&q->nonempty, &q->lock)
+                  : pthread_cond_timedwait(&q->nonempty, &q->lock, &deadline);
+        q->waiters--;
+        if (err == ETIMEDOUT)
+            break;
+    }
+    // An element may still have come in just as the wait timed out
+    if (!list_empty(&q->head)) {
+        e = list_first_entry(&q->head, element_t, list);
+        list_del(&e->list);
+        if (!--q->size && q->efd >= 0) {
+            uint64_t cnt;
+            // Cannot fail: the counter is 1 until now
+            if (read(q->efd, &cnt, sizeof(cnt)) < 0)
+                abort();
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+    return e;
+}
+
+int bkq_fd(bk_queue_t *q)
+{
+    int fd;
+    pthread_mutex_lock(&q->lock);
+    if (q->efd < 0)
+        q->efd = eventfd(q->size > 0, EFD_NONBLOCK | EFD_CLOEXEC);
+    fd = q->efd;
+    pthread_mutex_unlock(&q->lock);
+    return fd;
+}
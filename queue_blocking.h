@@ -0,0 +1,72 @@
+#ifndef LAB0_QUEUE_BLOCKING_H
+#define LAB0_QUEUE_BLOCKING_H
+
+/*
+ * Blocking concurrent queue of elements, for consumers to wait on instead of
+ * polling.
+ *
+ * Consumers wait on a condition variable, and each insertion wakes one of
+ * them. For event loops, the queue also provides an eventfd that is readable
+ * as long as the queue is not empty, so that select() or poll() can wait for
+ * it along with other file descriptors.
+ */
+
+#include "queue.h"
+
+typedef struct bk_queue bk_queue_t;
+
+/*
+ * Create empty queue.
+ * Return NULL if could not allocate space.
+ */
+bk_queue_t *bkq_new(void);
+
+/*
+ * Free queue and the elements left in it, and close its file descriptor.
+ * No other thread may be using it.
+ * No effect if q is NULL.
+ */
+void bkq_free(bk_queue_t *q);
+
+/*
+ * Attempt to insert element at tail of queue, as q_insert_tail(), and wake
+ * one consumer waiting for it.
+ * Return true if successful.
+ * Return false if could not allocate space.
+ */
+bool bkq_insert_tail(bk_queue_t *q, char *s);
+
+/*
+ * Attempt to remove element from head of queue, as q_remove_head(), waiting
+ * up to timeout_ms milliseconds for one to arrive if queue is empty. A
+ * negative timeout_ms waits as long as it takes.
+ * Return NULL if queue is still empty after timeout_ms.
+ */
+element_t *bkq_remove_head(bk_queue_t *q,
+                           char *sp,
+                           size_t bufsize,
+                           int timeout_ms);
+
+/*
+ * Insert element e, which the queue takes over, at tail of queue, and wake
+ * one consumer waiting for it.
+ */
+void bkq_enqueue(bk_queue_t *q, element_t *e);
+
+/*
+ * Remove element from head of queue, handing it over to the caller, waiting
+ * up to timeout_ms milliseconds as bkq_remove_head().
+ * Return NULL if queue is still empty after timeout_ms.
+ */
+element_t *bkq_dequeue(bk_queue_t *q, int timeout_ms);
+
+/*
+ * Return a file descriptor which is readable whenever queue is not empty,
+ * created on the first call. Readiness only tells that an element was there:
+ * another consumer may take it first, so remove it with a timeout of 0.
+ * The descriptor must not be read from or closed by the caller.
+ * Return -1 if could not create it.
+ */
+int bkq_fd(bk_queue_t *q);
+
+#endif /* LAB0_QUEUE_BLOCKING_H */
@@ -0,0 +1,208 @@
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_combining.h"
+
+/* Most passes over the slots a combiner makes before letting go of the lock */
+#define FC_PASSES 3
+
+/* Operations published in slots */
+enum fc_op {
+    FC_NONE,   /* Nothing to do, or done */
+    FC_INSERT, /* q_insert_tail(l, s) */
+    FC_REMOVE, /* q_remove_head(l, sp, bufsize) */
+};
+
+/*
+ * Slot a thread takes for one operation, starting with the one it took last,
+ * so that slots rarely move between threads.
+ */
+struct fc_slot {
+    atomic_bool busy;
+    atomic_int op;
+    char *s;
+    char *sp;
+    size_t bufsize;
+    bool ok;       /* Result of FC_INSERT */
+    element_t *e;  /* Result of FC_REMOVE */
+};
+
+struct fc_queue {
+    /* Combiner side */
+    union {
+        struct {
+            atomic_bool lock;
+            struct list_head *l;
+        };
+        char lock_line[CACHE_LINE];
+    };
+    /* Number of slots ever taken, so that combiners skip the others */
+    union {
+        atomic_int used;
+        char used_line[CACHE_LINE];
+    };
+    union {
+        struct fc_slot slot;
+        char slot_line[CACHE_LINE];
+    } slots[FCQ_THREADS_MAX];
+};
+
+/* Slot index each thread tries first */
+static _Thread_local int slot_hint = -1;
+
+/* Source of the first slot index of each thread */
+static atomic_uint next_hint;
+
+/*
+ * Publish operation op of the slot of the calling thread, and wait for it to
+ * be done, combining it with those of other threads if no one else is.
+ */
+static void publish(fc_queue_t *q, struct fc_slot *r, enum fc_op op);
+
+/*
+ * Take a free slot of queue q, waiting for one if all are busy.
+ */
+static struct fc_slot *slot_acquire(fc_queue_t *q);
+
+/*
+ * Give slot r back.
+ */
+static void slot_release(struct fc_slot *r);
+
+/*
+ * Do the operations published in the slots of queue q, with its lock held.
+ */
+static void combine(fc_queue_t *q);
+
+fc_queue_t *fcq_new(void)
+{
+    fc_queue_t *const q = malloc(sizeof(fc_queue_t));
+    if (!q)
+        return NULL;
+    q->l = q_new();
+    if (!q->l) {
+        free(q);
+        return NULL;
+    }
+    atomic_init(&q->lock, false);
+    atomic_init(&q->used, 0);
+    for (int i = 0; i < FCQ_THREADS_MAX; i++) {
+        atomic_init(&q->slots[i].slot.busy, false);
+        atomic_init(&q->slots[i].slot.op, FC_NONE);
+    }
+    q_set_threaded(true);
+    return q;
+}
+
+void fcq_free(fc_queue_t *q)
+{
+    if (!q)
+        return;
+    q_free(q->l);
+    q_set_threaded(false);
+    free(q);
+}
+
+bool fcq_insert_tail(fc_queue_t *q, char *s)
+{
+    struct fc_slot *const r = slot_acquire(q);
+    bool ok;
+    r->s = s;
+    publish(q, r, FC_INSERT);
+    ok = r->ok;
+    slot_release(r);
+    return ok;
+}
+
+element_t *fcq_remove_head(fc_queue_t *q, char *sp, size_t bufsize)
+{
+    struct fc_slot *const r = slot_acquire(q);
+    element_t *e;
+    r->sp = sp;
+    r->bufsize = bufsize;
+    publish(q, r, FC_REMOVE);
+    e = r->e;
+    slot_release(r);
+    return e;
+}
+
+/*
+ * Publish operation op of the slot of the calling thread, and wait for it to
+ * be done, combining it with those of other threads if no one else is.
+ */
+static void publish(fc_queue_t *q, struct fc_slot *r, enum fc_op op)
+{
+    // Release, so that the combiner sees the arguments
+    atomic_store_explicit(&r->op, op, memory_order_release);
+    while (atomic_load_explicit(&r->op, memory_order_acquire) != FC_NONE) {
+        if (!atomic_load_explicit(&q->lock, memory_order_relaxed) &&
+            !atomic_exchange_explicit(&q->lock, true, memory_order_acquire)) {
+            combine(q);
+            atomic_store_explicit(&q->lock, false, memory_order_release);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/*
+ * Take a free slot of queue q, waiting for one if all are busy.
+ */
+static struct fc_slot *slot_acquire(fc_queue_t *q)
+{
+    if (slot_hint < 0)
+        slot_hint = atomic_fetch_add(&next_hint, 1) % FCQ_THREADS_MAX;
+    for (int i = slot_hint;; i = (i + 1) % FCQ_THREADS_MAX) {
+        struct fc_slot *const r = &q->slots[i].slot;
+        if (!atomic_load_explicit(&r->busy, memory_order_relaxed) &&
+            !atomic_exchange_explicit(&r->busy, true, memory_order_acquire)) {
+            int used = atomic_load(&q->used);
+            while (used <= i &&
+                   !atomic_compare_exchange_weak(&q->used, &used, i + 1))
+                ;
+            slot_hint = i;
+            return r;
+        }
+    }
+}
+
+/*
+ * Give slot r back.
+ */
+static void slot_release(struct fc_slot *r)
+{
+    atomic_store_explicit(&r->busy, false, memory_order_release);
+}
+
+/*
+ * Do the operations published in the slots of queue q, with its lock held.
+ */
+static void combine(fc_queue_t *q)
+{
+    for (int pass = 0; pass < FC_PASSES; pass++) {
+        const int used = atomic_load(&q->used);
+        bool served = false;
+        for (int i = 0; i < used; i++) {
+            struct fc_slot *const r = &q->slots[i].slot;
+            switch (atomic_load_explicit(&r->op, memory_order_acquire)) {
+            case FC_INSERT:
+                r->ok = q_insert_tail(q->l, r->s);
+                break;
+            case FC_REMOVE:
+                r->e = q_remove_head(q->l, r->sp, r->bufsize);
+                break;
+            default:
+                continue;
+            }
+            // Release, so that the thread waiting sees the result
+            atomic_store_explicit(&r->op, FC_NONE, memory_order_release);
+            served = true;
+        }
+        // Later passes only pay off while threads keep publishing
+        if (!served)
+            break;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LAB0_QUEUE_COMBINING_H
+#define LAB0_QUEUE_COMBINING_H
+
+/*
+ * Concurrent wrapper of the sequential q_* functions by flat combining, after
+ * D. Hendler, I. Incze, N. Shavit and M. Tzafrir, "Flat Combining and the
+ * Synchronization-Parallelism Tradeoff", SPAA 2010.
+ *
+ * A thread publishes its operation in a slot of its own, and then either
+ * waits for it to be done or, if no other thread is the combiner, becomes the
+ * combiner and applies all operations published so far to the queue in one
+ * pass over the slots. The queue and the lock stay in the cache of the
+ * combiner, while each other thread only exchanges the cache line of its
+ * slot with it.
+ */
+
+#include "queue.h"
+
+/* Most threads that may operate on a queue at once */
+#define FCQ_THREADS_MAX 64
+
+typedef struct fc_queue fc_queue_t;
+
+/*
+ * Create empty queue, as q_new().
+ * Return NULL if could not allocate space.
+ */
+fc_queue_t *fcq_new(void);
+
+/*
+ * Free queue and the elements left in it. No other thread may be using it.
+ * No effect if q is NULL.
+ */
+void fcq_free(fc_queue_t *q);
+
+/*
+ * Attempt to insert element at tail of queue by q_insert_tail().
+ * Return true if successful.
+ * Return false if could not allocate space.
+ */
+bool fcq_insert_tail(fc_queue_t *q, char *s);
+
+/*
+ * Attempt to remove element from head of queue by q_remove_head().
+ * Return NULL if queue is empty.
+ */
+element_t *fcq_remove_head(fc_queue_t *q, char *sp, size_t bufsize);
+
+#endif /* LAB0_QUEUE_COMBINING_H */
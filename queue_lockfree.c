@@ -0,0 +1,372 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_lockfree.h"
+
+/* Hazard pointers per thread: the node at head or tail, and its successor */
+#define HAZARDS 2
+
+/* Nodes a record retires before scanning the hazard pointers to free them */
+#define RETIRE_THRESHOLD (2 * HAZARDS * LFQ_THREADS_MAX)
+
+struct lfq_node {
+    _Atomic(struct lfq_node *) next;
+    element_t *e;                  /* NULL in the dummy node */
+    struct lfq_node *retired_next; /* Next node retired in the same record */
+};
+
+/*
+ * Hazard pointers and retired nodes of the operation a thread is in the
+ * middle of. A thread takes a free record for each operation, starting with
+ * the one it took last, so that records rarely move between threads.
+ */
+struct hp_rec {
+    atomic_bool busy;
+    _Atomic(struct lfq_node *) hp[HAZARDS];
+    struct lfq_node *retired; /* Nodes taken out but maybe still read */
+    int retired_cnt;
+    struct lfq_node *spare; /* Free nodes for insertions, through `next` */
+};
+
+struct lf_queue {
+    union {
+        _Atomic(struct lfq_node *) head;
+        char head_line[CACHE_LINE];
+    };
+    union {
+        _Atomic(struct lfq_node *) tail;
+        char tail_line[CACHE_LINE];
+    };
+    /* Nodes freed by retire(), linked through `retired_next`, which records
+     * only ever take all at once, so that a node cannot leave and come back
+     * between reading it and its successor
+     */
+    union {
+        _Atomic(struct lfq_node *) recycled;
+        char recycled_line[CACHE_LINE];
+    };
+    union {
+        struct hp_rec rec;
+        char rec_line[CACHE_LINE];
+    } recs[LFQ_THREADS_MAX];
+};
+
+/* Record index each thread tries first */
+static _Thread_local int rec_hint = -1;
+
+/* Source of the first record index of each thread */
+static atomic_uint next_hint;
+
+/*
+ * Take a free hazard pointer record of queue q, waiting for one if all are
+ * busy.
+ */
+static struct hp_rec *rec_acquire(lf_queue_t *q);
+
+/*
+ * Clear the hazard pointers of record r and give it back.
+ */
+static void rec_release(struct hp_rec *r);
+
+/*
+ * Protect the node read from `src` with hazard pointer `hp`, reading it again
+ * until it is known not to have been freed in between.
+ * Return the node.
+ */
+static struct lfq_node *protect(_Atomic(struct lfq_node *) *hp,
+                                _Atomic(struct lfq_node *) *src);
+
+/*
+ * Retire node n through record r, and recycle the nodes retired so far that
+ * no hazard pointer holds once there are enough of them.
+ */
+static void retire(lf_queue_t *q, struct hp_rec *r, struct lfq_node *n);
+
+/*
+ * Take a free node for an insertion through record r, from its spare nodes,
+ * or else the nodes recycled by all records, or else malloc().
+ * Return NULL if could not allocate space.
+ */
+static struct lfq_node *node_get(lf_queue_t *q, struct hp_rec *r);
+
+/*
+ * Move pointer p from node `from` on to node `to`, unless another thread has
+ * moved it already.
+ */
+static void swing(_Atomic(struct lfq_node *) *p,
+                  struct lfq_node *from,
+                  struct lfq_node *to);
+
+lf_queue_t *lfq_new(void)
+{
+    lf_queue_t *const q = malloc(sizeof(lf_queue_t));
+    struct lfq_node *dummy;
+    if (!q)
+        return NULL;
+    dummy = malloc(sizeof(struct lfq_node));
+    if (!dummy) {
+        free(q);
+        return NULL;
+    }
+    atomic_init(&dummy->next, NULL);
+    dummy->e = NULL;
+    atomic_init(&q->head, dummy);
+    atomic_init(&q->tail, dummy);
+    atomic_init(&q->recycled, NULL);
+    for (int i = 0; i < LFQ_THREADS_MAX; i++) {
+        struct hp_rec *const r = &q->recs[i].rec;
+        atomic_init(&r->busy, false);
+        for (int j = 0; j < HAZARDS; j++)
+            atomic_init(&r->hp[j], NULL);
+        r->retired = NULL;
+        r->retired_cnt = 0;
+        r->spare = NULL;
+    }
+    q_set_threaded(true);
+    return q;
+}
+
+void lfq_free(lf_queue_t *q)
+{
+    struct lfq_node *n, *next;
+    if (!q)
+        return;
+    for (int i = 0; i < LFQ_THREADS_MAX; i++) {
+        for (n = q->recs[i].rec.retired; n; n = next) {
+            next = n->retired_next;
+            free(n);
+        }
+        for (n = q->recs[i].rec.spare; n; n = next) {
+            next = atomic_load(&n->next);
+            free(n);
+        }
+    }
+    for (n = atomic_load(&q->recycled); n; n = next) {
+        next = n->retired_next;
+        free(n);
+    }
+    // Only the dummy node at head holds no element
+    n = atomic_load(&q->head);
+    for (next = atomic_load(&n->next); next; next = atomic_load(&n->next)) {
+        free(n);
+        n = next;
+        element_free(n->e);
+    }
+    free(n);
+    free(q);
+    element_trim();
+    q_set_threaded(false);
+}
+
+bool lfq_insert_tail(lf_queue_t *q, char *s)
+{
+    element_t *const e = element_new(s);
+    if (!e)
+        return false;
+    if (!lfq_enqueue(q, e)) {
+        element_free(e);
+        return false;
+    }
+    return true;
+}
+
+element_t *lfq_remove_head(lf_queue_t *q, char *sp, size_t bufsize)
+{
+    element_t *const e = lfq_dequeue(q);
+    if (e)
+        element_copy_string(e, sp, bufsize);
+    return e;
+}
+
+bool lfq_enqueue(lf_queue_t *q, element_t *e)
+{
+    struct hp_rec *const r = rec_acquire(q);
+    struct lfq_node *const n = node_get(q, r);
+    if (!n) {
+        rec_release(r);
+        return false;
+    }
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    n->e = e;
+    for (;;) {
+        struct lfq_node *const tail = protect(&r->hp[0], &q->tail);
+        struct lfq_node *next = atomic_load(&tail->next);
+        if (next) {
+            // Tail lags behind, help the inserting thread move it first
+            swing(&q->tail, tail, next);
+            continue;
+        }
+        if (atomic_compare_exchange_strong(&tail->next, &next, n)) {
+            swing(&q->tail, tail, n);
+            break;
+        }
+    }
+    rec_release(r);
+    return true;
+}
+
+element_t *lfq_dequeue(lf_queue_t *q)
+{
+    struct hp_rec *const r = rec_acquire(q);
+    struct lfq_node *head, *next;
+    element_t *e;
+    for (;;) {
+        head = protect(&r->hp[0], &q->head);
+        next = protect(&r->hp[1], &head->next);
+        // Once head is seen again, next was its successor while protected
+        if (head != atomic_load(&q->head))
+            continue;
+        if (!next) {
+            rec_release(r);
+            return NULL;
+        }
+        if (head == atomic_load(&q->tail)) {
+            swing(&q->tail, head, next);
+            continue;
+        }
+        // The element must be read before another thread may take next
+        e = next->e;
+        if (atomic_compare_exchange_strong(&q->head, &head, next))
+            break;
+    }
+    // The old dummy node goes, and next becomes the dummy
+    retire(q, r, head);
+    rec_release(r);
+    return e;
+}
+
+/*
+ * Take a free hazard pointer record of queue q, waiting for one if all are
+ * busy.
+ */
+static struct hp_rec *rec_acquire(lf_queue_t *q)
+{
+    if (rec_hint < 0)
+        rec_hint = atomic_fetch_add(&next_hint, 1) % LFQ_THREADS_MAX;
+    for (int i = rec_hint;; i = (i + 1) % LFQ_THREADS_MAX) {
+        struct hp_rec *const r = &q->recs[i].rec;
+        if (!atomic_load_explicit(&r->busy, memory_order_relaxed) &&
+            !atomic_exchange_explicit(&r->busy, true, memory_order_acquire)) {
+            rec_hint = i;
+            return r;
+        }
+    }
+}
+
+/*
+ * Clear the hazard pointers of record r and give it back.
+ */
+static void rec_release(struct hp_rec *r)
+{
+    for (int i = 0; i < HAZARDS; i++)
+        atomic_store_explicit(&r->hp[i], NULL, memory_order_release);
+    atomic_store_explicit(&r->busy, false, memory_order_release);
+}
+
+/*
+ * Protect the node read from `src` with hazard pointer `hp`, reading it again
+ * until it is known not to have been freed in between.
+ * Return the node.
+ */
+static struct lfq_node *protect(_Atomic(struct lfq_node *) *hp,
+                                _Atomic(struct lfq_node *) *src)
+{
+    struct lfq_node *n = atomic_load(src), *again;
+    // Sequentially consistent, so that a scan missing the hazard pointer
+    // comes after the node has left `src`, and is then seen here
+    for (;; n = again) {
+        atomic_store(hp, n);
+        again = atomic_load(src);
+        if (again == n)
+            return n;
+    }
+}
+
+/* Order nodes by address, for qsort() */
+static int cmp_nodes(const void *a, const void *b)
+{
+    const struct lfq_node *const x = *(struct lfq_node *const *) a;
+    const struct lfq_node *const y = *(struct lfq_node *const *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Retire node n through record r, and recycle the nodes retired so far that
+ * no hazard pointer holds once there are enough of them.
+ */
+static void retire(lf_queue_t *q, struct hp_rec *r, struct lfq_node *n)
+{
+    struct lfq_node *hazards[LFQ_THREADS_MAX * HAZARDS], *list, *next;
+    struct lfq_node *freed = NULL, *last = NULL;
+    size_t cnt = 0;
+    n->retired_next = r->retired;
+    r->retired = n;
+    if (++r->retired_cnt < RETIRE_THRESHOLD)
+        return;
+    for (int i = 0; i < LFQ_THREADS_MAX; i++) {
+        for (int j = 0; j < HAZARDS; j++) {
+            struct lfq_node *const h = atomic_load(&q->recs[i].rec.hp[j]);
+            if (h)
+                hazards[cnt++] = h;
+        }
+    }
+    qsort(hazards, cnt, sizeof(hazards[0]), cmp_nodes);
+    list = r->retired;
+    r->retired = NULL;
+    r->retired_cnt = 0;
+    for (; list; list = next) {
+        next = list->retired_next;
+        if (bsearch(&list, hazards, cnt, sizeof(hazards[0]), cmp_nodes)) {
+            list->retired_next = r->retired;
+            r->retired = list;
+            r->retired_cnt++;
+        } else {
+            if (!freed)
+                last = list;
+            list->retired_next = freed;
+            freed = list;
+        }
+    }
+    // Hand them over to insertions, which are mostly in other threads
+    if (freed) {
+        last->retired_next = atomic_load(&q->recycled);
+        while (!atomic_compare_exchange_weak(&q->recycled,
+                                             &last->retired_next, freed))
+            ;
+    }
+}
+
+/*
+ * Take a free node for an insertion through record r, from its spare nodes,
+ * or else the nodes recycled by all records, or else malloc().
+ * Return NULL if could not allocate space.
+ */
+static struct lfq_node *node_get(lf_queue_t *q, struct hp_rec *r)
+{
+    struct lfq_node *n = r->spare;
+    if (!n) {
+        // Relink them through `next`, which no other thread reads any more
+        for (n = atomic_exchange(&q->recycled, NULL); n; n = n->retired_next) {
+            atomic_store_explicit(&n->next, r->spare, memory_order_relaxed);
+            r->spare = n;
+        }
+        n = r->spare;
+        if (!n)
+            return malloc(sizeof(struct lfq_node));
+    }
+    r->spare = atomic_load_explicit(&n->next, memory_order_relaxed);
+    return n;
+}
+
+/*
+ * Move pointer p from node `from` on to node `to`, unless another thread has
+ * moved it already.
+ */
+static void swing(_Atomic(struct lfq_node *) *p,
+                  struct lfq_node *from,
+                  struct lfq_node *to)
+{
+    atomic_compare_exchange_strong(p, &from, to);
+}
@@ -0,0 +1,69 @@
+#ifndef LAB0_QUEUE_LOCKFREE_H
+#define LAB0_QUEUE_LOCKFREE_H
+
+/*
+ * Lock-free multi-producer multi-consumer queue of elements, after
+ * M. M. Michael and M. L. Scott, "Simple, Fast, and Practical Non-Blocking and
+ * Blocking Concurrent Queue Algorithms", PODC 1996.
+ *
+ * Any number of threads may insert at tail and remove from head at once.
+ * Elements are linked through nodes of the queue's own, as the node at head
+ * is always a dummy. Nodes taken out are freed only once no thread may still
+ * read them, which each thread announces with hazard pointers, after
+ * M. M. Michael, "Hazard Pointers: Safe Memory Reclamation for Lock-Free
+ * Objects", IEEE TPDS 2004.
+ *
+ * Nodes freed that way are kept by the queue for later insertions instead of
+ * going back to malloc(), and elements with inline strings come from the
+ * thread caches of q_set_threaded(), so inserting and removing take no lock
+ * in the long run. Locks are still taken by malloc() until enough nodes are
+ * in circulation, by element allocation once per batch moved between a thread
+ * cache and the element pool, and for each element whose string is not
+ * inline or which is allocated while allocations may fail.
+ */
+
+#include "queue.h"
+
+/* Most threads operating on one queue at a time */
+#define LFQ_THREADS_MAX 64
+
+typedef struct lf_queue lf_queue_t;
+
+/*
+ * Create empty queue.
+ * Return NULL if could not allocate space.
+ */
+lf_queue_t *lfq_new(void);
+
+/*
+ * Free queue and the elements left in it. No other thread may be using it.
+ * No effect if q is NULL.
+ */
+void lfq_free(lf_queue_t *q);
+
+/*
+ * Attempt to insert element at tail of queue, as q_insert_tail().
+ * Return true if successful.
+ * Return false if could not allocate space.
+ */
+bool lfq_insert_tail(lf_queue_t *q, char *s);
+
+/*
+ * Attempt to remove element from head of queue, as q_remove_head().
+ * Return NULL if queue is empty.
+ */
+element_t *lfq_remove_head(lf_queue_t *q, char *sp, size_t bufsize);
+
+/*
+ * Insert element e, which the queue takes over, at tail of queue.
+ * Return false, leaving e to the caller, if could not allocate space.
+ */
+bool lfq_enqueue(lf_queue_t *q, element_t *e);
+
+/*
+ * Remove element from head of queue, handing it over to the caller.
+ * Return NULL if queue is empty.
+ */
+element_t *lfq_dequeue(lf_queue_t *q);
+
+#endif /* LAB0_QUEUE_LOCKFREE_H */
@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+
+/*
+ * Ring buffer backend.
+ *
+ * Element pointers are kept in one array whose capacity is a power of two,
+ * so that a logical position maps to a slot with a mask instead of a
+ * division. The array doubles when an insertion finds it full, and is never
+ * shrunk until the queue is freed. A ring_t linked into the list head of the
+ * queue holds the array.
+ */
+
+/* Initial capacity of the array */
+#define RING_MIN_SIZE 16
+
+typedef struct {
+    struct list_head list;
+    element_t **slots;
+    unsigned int mask;  /* Capacity minus one */
+    unsigned int first; /* Slot of the head element */
+} ring_t;
+
+#define ring_of(h) list_first_entry(h, ring_t, list)
+
+/* Slot of the element at position `i` from head */
+#define slot(r, i) ((r)->slots[((r)->first + (i)) & (r)->mask])
+
+/* Exchange the element pointers in slots x and y */
+#define swap_slots(x, y)          \
+    do {                          \
+        element_t *const tmp = x; \
+        x = y;                    \
+        y = tmp;                  \
+    } while (0)
+
+/*
+ * Double the capacity of ring r holding `size` elements.
+ * Return false if could not allocate space.
+ */
+static bool ring_grow(ring_t *r, unsigned int size);
+
+/*
+ * Reverse slots a[0], ..., a[n - 1].
+ */
+static void reverse_slots(element_t **a, unsigned int n);
+
+static bool ring_init(struct list_head *head)
+{
+    ring_t *const r = malloc(sizeof(ring_t));
+    if (!r)
+        return false;
+    r->slots = malloc(RING_MIN_SIZE * sizeof(element_t *));
+    if (!r->slots) {
+        free(r);
+        return false;
+    }
+    r->mask = RING_MIN_SIZE - 1;
+    r->first = 0;
+    list_add(&r->list, head);
+    return true;
+}
+
+static void ring_free(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    for (int i = 0; i < queue_of(head)->size; i++)
+        element_free(slot(r, i));
+    free(r->slots);
+    free(r);
+}
+
+static bool ring_insert_head(struct list_head *head, element_t *e)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size;
+    if (size > r->mask && !ring_grow(r, size))
+        return false;
+    r->first = (r->first - 1) & r->mask;
+    r->slots[r->first] = e;
+    return true;
+}
+
+static bool ring_insert_tail(struct list_head *head, element_t *e)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size;
+    if (size > r->mask && !ring_grow(r, size))
+        return false;
+    slot(r, size) = e;
+    return true;
+}
+
+static element_t *ring_remove_head(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    element_t *const e = r->slots[r->first];
+    r->first = (r->first + 1) & r->mask;
+    return e;
+}
+
+static element_t *ring_remove_tail(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    return slot(r, queue_of(head)->size - 1);
+}
+
+static element_t *ring_remove_mid(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size, mid = size / 2;
+    element_t *const e = slot(r, mid);
+    // Close the gap from whichever end is closer
+    if (mid < size - mid) {
+        for (unsigned int i = mid; i > 0; i--)
+            slot(r, i) = slot(r, i - 1);
+        r->first = (r->first + 1) & r->mask;
+    } else {
+        for (unsigned int i = mid; i + 1 < size; i++)
+            slot(r, i) = slot(r, i + 1);
+    }
+    return e;
+}
+
+static element_t *ring_peek_head(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    return r->slots[r->first];
+}
+
+static element_t *ring_peek_tail(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    return slot(r, queue_of(head)->size - 1);
+}
+
+static int ring_for_each(struct list_head *head,
+                         bool reversed,
+                         q_visit_t visit,
+                         void *priv)
+{
+    ring_t *const r = ring_of(head);
+    int size = queue_of(head)->size;
+    for (int i = 0; i < size; i++) {
+        if (!visit(slot(r, reversed ? size - 1 - i : i), priv))
+            return i + 1;
+    }
+    return size;
+}
+
+static int ring_delete_dup(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size, kept = 0;
+    bool is_prev_dup = false;
+    if (!size)
+        return 0;
+    // Each element is kept or released once its successor has been seen, and
+    // kept ones are packed towards the head
+    for (unsigned int i = 1; i <= size; i++) {
+        element_t *const prev = slot(r, i - 1);
+        bool is_dup = i < size && element_cmp(prev, slot(r, i)) == 0;
+        if (is_prev_dup || is_dup)
+            element_free(prev);
+        else
+            slot(r, kept++) = prev;
+        is_prev_dup = is_dup;
+    }
+    return size - kept;
+}
+
+static int ring_filter(struct list_head *head,
+                       q_visit_t keep,
+                       void *priv,
+                       struct list_head *out)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size, kept = 0;
+    for (unsigned int i = 0; i < size; i++) {
+        element_t *const e = slot(r, i);
+        if (keep(e, priv))
+            slot(r, kept++) = e;
+        else
+            list_add_tail(&e->list, out);
+    }
+    return size - kept;
+}
+
+static void ring_swap(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size;
+    for (unsigned int i = 0; i + 1 < size; i += 2)
+        swap_slots(slot(r, i), slot(r, i + 1));
+}
+
+static void ring_reverse(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    unsigned int size = queue_of(head)->size;
+    for (unsigned int i = 0, j = size - 1; i < j && j < size; i++, j--)
+        swap_slots(slot(r, i), slot(r, j));
+}
+
+static void ring_sort(struct list_head *head)
+{
+    ring_t *const r = ring_of(head);
+    // Rotate the array so that the elements are contiguous from slot 0
+    reverse_slots(r->slots, r->first);
+    reverse_slots(r->slots + r->first, r->mask + 1 - r->first);
+    reverse_slots(r->slots, r->mask + 1);
+    r->first = 0;
+    sort_elements(r->slots, queue_of(head)->size);
+}
+
+const struct queue_ops ring_ops = {
+    .init = ring_init,
+    .free = ring_free,
+    .insert_head = ring_insert_head,
+    .insert_tail = ring_insert_tail,
+    .remove_head = ring_remove_head,
+    .remove_tail = ring_remove_tail,
+    .remove_mid = ring_remove_mid,
+    .peek_head = ring_peek_head,
+    .peek_tail = ring_peek_tail,
+    .for_each = ring_for_each,
+    .delete_dup = ring_delete_dup,
+    .filter = ring_filter,
+    .swap = ring_swap,
+    .reverse = ring_reverse,
+    .sort = ring_sort,
+};
+
+/*
+ * Double the capacity of ring r holding `size` elements.
+ * Return false if could not allocate space.
+ */
+static bool ring_grow(ring_t *r, unsigned int size)
+{
+    unsigned int cap = (r->mask + 1) * 2;
+    element_t **slots;
+    if (!cap)
+        return false;
+    slots = malloc(cap * sizeof(element_t *));
+    if (!slots)
+        return false;
+    // Unwrap the elements to the beginning of the new array
+    for (unsigned int i = 0; i < size; i++)
+        slots[i] = slot(r, i);
+    free(r->slots);
+    r->slots = slots;
+    r->mask = cap - 1;
+    r->first = 0;
+    return true;
+}
+
+/*
+ * Reverse slots a[0], ..., a[n - 1].
+ */
+static void reverse_slots(element_t **a, unsigned int n)
+{
+    for (unsigned int i = 0, j = n - 1; i < j && j < n; i++, j--)
+        swap_slots(a[i], a[j]);
+}
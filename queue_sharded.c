@@ -0,0 +1,240 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_sharded.h"
+
+/*
+ * Sub-queue of elements. In strict mode, the tickets of its elements are
+ * kept in the same order in a circular array, which grows as needed.
+ */
+struct shard {
+    pthread_mutex_t lock;
+    struct list_head head;
+    atomic_int size; /* Read without the lock to skip empty shards */
+    unsigned long *tickets;
+    int first; /* Index of the ticket of the first element */
+    int cap;
+};
+
+struct sh_queue {
+    union {
+        struct {
+            int shards;
+            bool strict;
+        };
+        char const_line[CACHE_LINE];
+    };
+    union {
+        atomic_ulong next_ticket;
+        char ticket_line[CACHE_LINE];
+    };
+    union {
+        struct shard s;
+        char shard_lines[2 * CACHE_LINE];
+    } shard[];
+};
+
+/* Number of the calling thread, from 1 on, or 0 until it is given one */
+static _Thread_local unsigned thread_no;
+
+/* Shard the calling thread steals from next, relative to its home shard */
+static _Thread_local unsigned steal_next;
+
+/* Source of thread numbers */
+static atomic_uint threads;
+
+/*
+ * Return the index of the home shard of the calling thread in queue q.
+ */
+static int home_shard(sh_queue_t *q);
+
+/*
+ * Remove element from head of shard s, with its lock held.
+ * Return NULL if s is empty.
+ */
+static element_t *shard_pop(struct shard *s);
+
+/*
+ * Remove the element with the lowest ticket of all shards of queue q.
+ * Return NULL if queue is empty.
+ */
+static element_t *strict_dequeue(sh_queue_t *q);
+
+sh_queue_t *shq_new(int shards, bool strict)
+{
+    sh_queue_t *q;
+    if (shards < 1)
+        shards = 1;
+    q = malloc(sizeof(sh_queue_t) + shards * sizeof(q->shard[0]));
+    if (!q)
+        return NULL;
+    q->shards = shards;
+    q->strict = strict;
+    atomic_init(&q->next_ticket, 0);
+    for (int i = 0; i < shards; i++) {
+        struct shard *const s = &q->shard[i].s;
+        pthread_mutex_init(&s->lock, NULL);
+        INIT_LIST_HEAD(&s->head);
+        atomic_init(&s->size, 0);
+        s->tickets = NULL;
+        s->first = s->cap = 0;
+    }
+    q_set_threaded(true);
+    return q;
+}
+
+void shq_free(sh_queue_t *q)
+{
+    if (!q)
+        return;
+    for (int i = 0; i < q->shards; i++) {
+        struct shard *const s = &q->shard[i].s;
+        element_t *e, *tmp;
+        list_for_each_entry_safe (e, tmp, &s->head, list)
+            element_free(e);
+        free(s->tickets);
+        pthread_mutex_destroy(&s->lock);
+    }
+    free(q);
+    element_trim();
+    q_set_threaded(false);
+}
+
+bool shq_insert_tail(sh_queue_t *q, char *s)
+{
+    element_t *const e = element_new(s);
+    if (!e)
+        return false;
+    if (!shq_enqueue(q, e)) {
+        element_free(e);
+        return false;
+    }
+    return true;
+}
+
+element_t *shq_remove_head(sh_queue_t *q, char *sp, size_t bufsize)
+{
+    element_t *const e = shq_dequeue(q);
+    if (e)
+        element_copy_string(e, sp, bufsize);
+    return e;
+}
+
+bool shq_enqueue(sh_queue_t *q, element_t *e)
+{
+    struct shard *const s = &q->shard[home_shard(q)].s;
+    pthread_mutex_lock(&s->lock);
+    if (q->strict) {
+        const int size = atomic_load_explicit(&s->size, memory_order_relaxed);
+        if (size == s->cap) {
+            // Unwrap the tickets into an array twice as large
+            const int cap = s->cap ? 2 * s->cap : 16;
+            unsigned long *const t = malloc(cap * sizeof(unsigned long));
+            if (!t) {
+                pthread_mutex_unlock(&s->lock);
+                return false;
+            }
+            for (int i = 0; i < size; i++)
+                t[i] = s->tickets[(s->first + i) % s->cap];
+            free(s->tickets);
+            s->tickets = t;
+            s->first = 0;
+            s->cap = cap;
+        }
+        // Taken with the shard locked, so that a removal holding every lock
+        // finds all elements with a lower ticket than the lowest it sees
+        s->tickets[(s->first + size) % s->cap] =
+            atomic_fetch_add_explicit(&q->next_ticket, 1, memory_order_relaxed);
+    }
+    list_add_tail(&e->list, &s->head);
+    atomic_fetch_add_explicit(&s->size, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&s->lock);
+    return true;
+}
+
+element_t *shq_dequeue(sh_queue_t *q)
+{
+    struct shard *home;
+    element_t *e = NULL;
+    int h;
+    if (q->strict)
+        return strict_dequeue(q);
+    h = home_shard(q);
+    home = &q->shard[h].s;
+    if (atomic_load_explicit(&home->size, memory_order_relaxed)) {
+        pthread_mutex_lock(&home->lock);
+        e = shard_pop(home);
+        pthread_mutex_unlock(&home->lock);
+        if (e)
+            return e;
+    }
+    // Steal, starting each time from the shard after the last one visited
+    for (int i = 1; i < q->shards; i++) {
+        struct shard *s;
+        steal_next = steal_next % (q->shards - 1) + 1;
+        s = &q->shard[(h + steal_next) % q->shards].s;
+        if (!atomic_load_explicit(&s->size, memory_order_relaxed))
+            continue;
+        pthread_mutex_lock(&s->lock);
+        e = shard_pop(s);
+        pthread_mutex_unlock(&s->lock);
+        if (e)
+            break;
+    }
+    return e;
+}
+
+/*
+ * Return the index of the home shard of the calling thread in queue q.
+ */
+static int home_shard(sh_queue_t *q)
+{
+    if (!thread_no)
+        thread_no = atomic_fetch_add(&threads, 1) + 1;
+    return thread_no % q->shards;
+}
+
+/*
+ * Remove element from head of shard s, with its lock held.
+ * Return NULL if s is empty.
+ */
+static element_t *shard_pop(struct shard *s)
+{
+    element_t *e;
+    if (list_empty(&s->head))
+        return NULL;
+    e = list_first_entry(&s->head, element_t, list);
+    list_del(&e->list);
+    atomic_fetch_sub_explicit(&s->size, 1, memory_order_relaxed);
+    if (s->cap)
+        s->first = (s->first + 1) % s->cap;
+    return e;
+}
+
+/*
+ * Remove the element with the lowest ticket of all shards of queue q.
+ * Return NULL if queue is empty.
+ */
+static element_t *strict_dequeue(sh_queue_t *q)
+{
+    struct shard *oldest = NULL;
+    element_t *e = NULL;
+    // Always locked in the same order, so removals cannot deadlock
+    for (int i = 0; i < q->shards; i++)
+        pthread_mutex_lock(&q->shard[i].s.lock);
+    for (int i = 0; i < q->shards; i++) {
+        struct shard *const s = &q->shard[i].s;
+        if (!list_empty(&s->head) &&
+            (!oldest ||
+             s->tickets[s->first] < oldest->tickets[oldest->first]))
+            oldest = s;
+    }
+    if (oldest)
+        e = shard_pop(oldest);
+    for (int i = q->shards - 1; i >= 0; i--)
+        pthread_mutex_unlock(&q->shard[i].s.lock);
+    return e;
+}
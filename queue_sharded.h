@@ -0,0 +1,65 @@
+#ifndef LAB0_QUEUE_SHARDED_H
+#define LAB0_QUEUE_SHARDED_H
+
+/*
+ * Concurrent queue of elements split into shards, each a list of elements
+ * behind its own lock, so that threads working on different shards do not
+ * contend for one head and one tail.
+ *
+ * Each thread inserts into its home shard, so the elements of any one
+ * producer come out in the order it inserted them. Each thread removes from
+ * its home shard as well, and when that is empty steals from the others,
+ * visited round-robin. Elements of different producers may come out in any
+ * order.
+ *
+ * In strict mode, the queue stamps each element with a ticket as it is
+ * inserted, and removal takes the element with the lowest ticket of all
+ * shards, which orders all elements as a single queue would but needs every
+ * shard lock.
+ */
+
+#include "queue.h"
+
+typedef struct sh_queue sh_queue_t;
+
+/*
+ * Create empty queue of `shards` shards, removing elements in the order they
+ * were inserted in if strict.
+ * Return NULL if could not allocate space.
+ */
+sh_queue_t *shq_new(int shards, bool strict);
+
+/*
+ * Free queue and the elements left in it. No other thread may be using it.
+ * No effect if q is NULL.
+ */
+void shq_free(sh_queue_t *q);
+
+/*
+ * Attempt to insert element at tail of the home shard of the calling thread,
+ * as q_insert_tail().
+ * Return true if successful.
+ * Return false if could not allocate space.
+ */
+bool shq_insert_tail(sh_queue_t *q, char *s);
+
+/*
+ * Attempt to remove element from head of queue, as q_remove_head().
+ * Return NULL if every shard was found empty.
+ */
+element_t *shq_remove_head(sh_queue_t *q, char *sp, size_t bufsize);
+
+/*
+ * Insert element e, which the queue takes over, at tail of the home shard of
+ * the calling thread.
+ * Return false, leaving e to the caller, if could not allocate space.
+ */
+bool shq_enqueue(sh_queue_t *q, element_t *e);
+
+/*
+ * Remove element from head of queue, handing it over to the caller.
+ * Return NULL if every shard was found empty.
+ */
+element_t *shq_dequeue(sh_queue_t *q);
+
+#endif /* LAB0_QUEUE_SHARDED_H */
@@ -0,0 +1,232 @@
+#include "queue_backend.h"
+
+/*
+ * Pattern-defeating quicksort of arrays of element pointers, after
+ * https://github.com/orlp/pdqsort
+ *
+ * Sorting pointers held in one array touches memory sequentially, except for
+ * the strings compared, where merge sorting a long list keeps following links
+ * to scattered nodes. On top of an introsort (quicksort falling back to
+ * heapsort on bad pivots, insertion sort for small ranges), it skips runs of
+ * elements equal to an earlier pivot, and finishes off ranges found already
+ * partitioned with an insertion sort that gives up after a few moves.
+ */
+
+/* Ranges of up to this many elements are insertion sorted */
+#define INSERTION_SORT_MAX 24
+
+/* Ranges of more than this many elements take a pivot among nine elements */
+#define NINTHER_MIN 128
+
+/* Elements a partial insertion sort may move before giving up */
+#define PARTIAL_INSERTION_MAX 8
+
+#define less(x, y) (element_cmp(x, y) < 0)
+
+/* Exchange the element pointers in x and y */
+#define swap_ptrs(x, y)           \
+    do {                          \
+        element_t *const tmp = x; \
+        x = y;                    \
+        y = tmp;                  \
+    } while (0)
+
+/*
+ * Order a[i], a[j] and a[k] so that a[i] <= a[j] <= a[k].
+ */
+static void sort3(element_t **a, size_t i, size_t j, size_t k)
+{
+    if (less(a[j], a[i]))
+        swap_ptrs(a[i], a[j]);
+    if (less(a[k], a[j])) {
+        swap_ptrs(a[j], a[k]);
+        if (less(a[j], a[i]))
+            swap_ptrs(a[i], a[j]);
+    }
+}
+
+/*
+ * Insertion sort a[0], ..., a[n - 1], giving up once more than
+ * PARTIAL_INSERTION_MAX elements have been moved if `partial` is true.
+ * Return whether the range is sorted.
+ */
+static bool insertion_sort(element_t **a, size_t n, bool partial)
+{
+    size_t moves = 0;
+    for (size_t i = 1; i < n; i++) {
+        element_t *const e = a[i];
+        size_t j = i;
+        for (; j > 0 && less(e, a[j - 1]); j--)
+            a[j] = a[j - 1];
+        a[j] = e;
+        moves += i - j;
+        if (partial && moves > PARTIAL_INSERTION_MAX)
+            return i + 1 == n;
+    }
+    return true;
+}
+
+/*
+ * Heapsort a[0], ..., a[n - 1], for when pivots keep going wrong.
+ */
+static void heap_sort(element_t **a, size_t n)
+{
+    for (size_t end = n, i = n / 2; end > 1;) {
+        size_t root, child;
+        if (i > 0) {
+            // Build the heap
+            root = --i;
+        } else {
+            // Move the largest element left in the heap behind it
+            swap_ptrs(a[0], a[--end]);
+            root = 0;
+        }
+        while ((child = 2 * root + 1) < end) {
+            if (child + 1 < end && less(a[child], a[child + 1]))
+                child++;
+            if (!less(a[root], a[child]))
+                break;
+            swap_ptrs(a[root], a[child]);
+            root = child;
+        }
+    }
+}
+
+/*
+ * Partition a[0], ..., a[n - 1] around pivot a[0], putting the elements less
+ * than it on its left, and set *is_partitioned if no element had to move.
+ * There must be an element not less than the pivot after it.
+ * Return the final position of the pivot.
+ */
+static size_t partition_right(element_t **a, size_t n, bool *is_partitioned)
+{
+    element_t *const pivot = a[0];
+    size_t first = 0, last = n;
+    while (less(a[++first], pivot))
+        ;
+    // Without an element less than the pivot in front, guard the scan
+    if (first == 1) {
+        while (first < last && !less(a[--last], pivot))
+            ;
+    } else {
+        while (!less(a[--last], pivot))
+            ;
+    }
+    *is_partitioned = first >= last;
+    while (first < last) {
+        swap_ptrs(a[first], a[last]);
+        while (less(a[++first], pivot))
+            ;
+        while (!less(a[--last], pivot))
+            ;
+    }
+    a[0] = a[first - 1];
+    a[first - 1] = pivot;
+    return first - 1;
+}
+
+/*
+ * Partition a[0], ..., a[n - 1] around pivot a[0], putting the elements not
+ * greater than it on its left. Used when no element of the range is less than
+ * the pivot, so that the left part ends up all equal to it.
+ * Return the final position of the pivot.
+ */
+static size_t partition_left(element_t **a, size_t n)
+{
+    element_t *const pivot = a[0];
+    size_t first = 0, last = n;
+    while (less(pivot, a[--last]))
+        ;
+    if (last + 1 == n) {
+        while (first < last && !less(pivot, a[++first]))
+            ;
+    } else {
+        while (!less(pivot, a[++first]))
+            ;
+    }
+    while (first < last) {
+        swap_ptrs(a[first], a[last]);
+        while (less(pivot, a[--last]))
+            ;
+        while (!less(pivot, a[++first]))
+            ;
+    }
+    a[0] = a[last];
+    a[last] = pivot;
+    return last;
+}
+
+/*
+ * Sort a[0], ..., a[n - 1], falling back to heapsort after `bad_allowed`
+ * highly unbalanced partitions. Unless `leftmost` is true, a[-1] is the pivot
+ * of an enclosing partition, not greater than any element of the range.
+ */
+static void pdq_sort(element_t **a, size_t n, int bad_allowed, bool leftmost)
+{
+    while (n > INSERTION_SORT_MAX) {
+        size_t half = n / 2, pos, l, r;
+        bool is_partitioned;
+        // Move the pivot to a[0], leaving a greater one at the end as a guard
+        if (n > NINTHER_MIN) {
+            sort3(a, 0, half, n - 1);
+            sort3(a, 1, half - 1, n - 2);
+            sort3(a, 2, half + 1, n - 3);
+            sort3(a, half - 1, half, half + 1);
+            swap_ptrs(a[0], a[half]);
+        } else {
+            sort3(a, half, 0, n - 1);
+        }
+        // A pivot equal to the one before the range takes the elements equal
+        // to it away at once, which are then in place
+        if (!leftmost && !less(a[-1], a[0])) {
+            pos = partition_left(a, n);
+            a += pos + 1;
+            n -= pos + 1;
+            continue;
+        }
+        pos = partition_right(a, n, &is_partitioned);
+        l = pos;
+        r = n - pos - 1;
+        if (l < n / 8 || r < n / 8) {
+            if (--bad_allowed == 0) {
+                heap_sort(a, n);
+                return;
+            }
+            // Shuffle a few elements to break the pattern
+            if (l >= INSERTION_SORT_MAX) {
+                swap_ptrs(a[0], a[l / 4]);
+                swap_ptrs(a[pos - 1], a[pos - l / 4]);
+            }
+            if (r >= INSERTION_SORT_MAX) {
+                swap_ptrs(a[pos + 1], a[pos + 1 + r / 4]);
+                swap_ptrs(a[n - 1], a[n - r / 4]);
+            }
+        } else if (is_partitioned && insertion_sort(a, l, true) &&
+                   insertion_sort(a + pos + 1, r, true)) {
+            return;
+        }
+        // Recurse into the smaller part only, to bound the stack
+        if (l < r) {
+            pdq_sort(a, l, bad_allowed, leftmost);
+            a += pos + 1;
+            n = r;
+            leftmost = false;
+        } else {
+            pdq_sort(a + pos + 1, r, bad_allowed, false);
+            n = l;
+        }
+    }
+    insertion_sort(a, n, false);
+}
+
+/*
+ * Sort element pointers a[0], ..., a[n - 1] in ascending order of their
+ * strings, in place. The sort is not stable.
+ */
+void sort_elements(element_t **a, size_t n)
+{
+    int log2 = 0;
+    for (size_t i = n; i > 1; i >>= 1)
+        log2++;
+    pdq_sort(a, n, log2 + 1, true);
+}
@@ -0,0 +1,134 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_spsc.h"
+
+/*
+ * Elements are at slots[i & mask] for head <= i < tail, and the producer has
+ * staged more up to `staged`. Indices only grow, and wrap around together.
+ */
+struct sp_queue {
+    /* Written by the consumer */
+    union {
+        struct {
+            atomic_size_t head;
+            size_t tail_seen; /* Last tail the consumer read */
+        };
+        char head_line[CACHE_LINE];
+    };
+    /* Written by the producer */
+    union {
+        struct {
+            atomic_size_t tail;
+            size_t staged;    /* Index after the last element staged */
+            size_t head_seen; /* Last head the producer read */
+        };
+        char tail_line[CACHE_LINE];
+    };
+    /* Read only */
+    union {
+        struct {
+            size_t mask;
+            size_t batch;
+        };
+        char const_line[CACHE_LINE];
+    };
+    element_t *slots[];
+};
+
+sp_queue_t *spq_new(size_t capacity, size_t batch)
+{
+    size_t size = 1;
+    sp_queue_t *q;
+    while (size < capacity)
+        size <<= 1;
+    q = malloc(sizeof(sp_queue_t) + size * sizeof(element_t *));
+    if (!q)
+        return NULL;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->tail_seen = q->staged = q->head_seen = 0;
+    q->mask = size - 1;
+    q->batch = batch ? batch : 1;
+    q_set_threaded(true);
+    return q;
+}
+
+void spq_free(sp_queue_t *q)
+{
+    if (!q)
+        return;
+    for (size_t i = atomic_load(&q->head); i != q->staged; i++)
+        element_free(q->slots[i & q->mask]);
+    free(q);
+    element_trim();
+    q_set_threaded(false);
+}
+
+bool spq_insert_tail(sp_queue_t *q, char *s)
+{
+    element_t *e;
+    if (!spq_room(q)) {
+        spq_publish(q);
+        return false;
+    }
+    e = element_new(s);
+    if (!e)
+        return false;
+    return spq_enqueue(q, e);
+}
+
+element_t *spq_remove_head(sp_queue_t *q, char *sp, size_t bufsize)
+{
+    element_t *const e = spq_dequeue(q);
+    if (e)
+        element_copy_string(e, sp, bufsize);
+    return e;
+}
+
+bool spq_enqueue(sp_queue_t *q, element_t *e)
+{
+    if (!spq_room(q)) {
+        // The consumer cannot make room out of elements it does not see
+        spq_publish(q);
+        return false;
+    }
+    q->slots[q->staged++ & q->mask] = e;
+    if (q->staged - atomic_load_explicit(&q->tail, memory_order_relaxed) >=
+        q->batch)
+        spq_publish(q);
+    return true;
+}
+
+void spq_publish(sp_queue_t *q)
+{
+    // Release, so that the slots are written before the consumer reads them
+    atomic_store_explicit(&q->tail, q->staged, memory_order_release);
+}
+
+element_t *spq_dequeue(sp_queue_t *q)
+{
+    const size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    element_t *e;
+    if (head == q->tail_seen) {
+        q->tail_seen = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head == q->tail_seen)
+            return NULL;
+    }
+    e = q->slots[head & q->mask];
+    // Release, so that the slot is read before the producer reuses it
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return e;
+}
+
+size_t spq_room(sp_queue_t *q)
+{
+    size_t room = q->mask + 1 - (q->staged - q->head_seen);
+    if (!room) {
+        q->head_seen = atomic_load_explicit(&q->head, memory_order_acquire);
+        room = q->mask + 1 - (q->staged - q->head_seen);
+    }
+    return room;
+}
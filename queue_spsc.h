@@ -0,0 +1,87 @@
+#ifndef LAB0_QUEUE_SPSC_H
+#define LAB0_QUEUE_SPSC_H
+
+/*
+ * Bounded queue of elements passed from one producer thread to one consumer
+ * thread, in a ring as in L. Lamport, "Specifying Concurrent Program Modules",
+ * TOPLAS 1983, with the cached indices and batched updates of MCRingBuffer in
+ * P. P. C. Lee, T. Bu and G. Chandranmenon, "A Lock-Free, Cache-Efficient
+ * Multi-Core Synchronization Mechanism for Line-Rate Network Traffic
+ * Monitoring", IPDPS 2010.
+ *
+ * spq_enqueue(), spq_publish(), spq_dequeue() and spq_room() each take a
+ * bounded number of steps, without locks: the producer alone writes tail and
+ * the consumer alone writes head, each on its own cache line, and each keeps
+ * a copy of the other index to read it only when the ring looks full or
+ * empty. The producer may stage several elements before making them visible
+ * with a single store, so that the consumer pulls in the cache line of tail
+ * once per batch.
+ *
+ * spq_insert_tail(), and releasing the elements removed, also allocate and
+ * free elements, which is not wait-free: the thread caches of
+ * q_set_threaded() take a lock once per batch of elements, and each time for
+ * elements whose string is not inline.
+ */
+
+#include "queue.h"
+
+typedef struct sp_queue sp_queue_t;
+
+/*
+ * Create empty queue holding up to capacity elements, rounded up to a power
+ * of 2, which publishes the elements the producer inserts once there are
+ * `batch` of them.
+ * Return NULL if could not allocate space.
+ */
+sp_queue_t *spq_new(size_t capacity, size_t batch);
+
+/*
+ * Free queue and the elements left in it, published or not. Neither thread
+ * may be using it.
+ * No effect if q is NULL.
+ */
+void spq_free(sp_queue_t *q);
+
+/*
+ * Attempt to insert element at tail of queue, as q_insert_tail(), from the
+ * producer thread.
+ * Return true if successful.
+ * Return false if queue is full or could not allocate space.
+ */
+bool spq_insert_tail(sp_queue_t *q, char *s);
+
+/*
+ * Attempt to remove element from head of queue, as q_remove_head(), from the
+ * consumer thread.
+ * Return NULL if queue is empty, or only holds elements not published yet.
+ */
+element_t *spq_remove_head(sp_queue_t *q, char *sp, size_t bufsize);
+
+/*
+ * Insert element e, which the queue takes over, at tail of queue from the
+ * producer thread, and publish the elements staged so far if there are
+ * `batch` of them.
+ * Return false, leaving e to the caller and publishing the elements staged
+ * so far, if queue is full.
+ */
+bool spq_enqueue(sp_queue_t *q, element_t *e);
+
+/*
+ * Make the elements staged by the producer thread visible to the consumer.
+ */
+void spq_publish(sp_queue_t *q);
+
+/*
+ * Remove element from head of queue from the consumer thread, handing it over
+ * to the caller.
+ * Return NULL if queue is empty, or only holds elements not published yet.
+ */
+element_t *spq_dequeue(sp_queue_t *q);
+
+/*
+ * Return how many more elements the producer thread can insert before the
+ * consumer removes some.
+ */
+size_t spq_room(sp_queue_t *q);
+
+#endif /* LAB0_QUEUE_SPSC_H */
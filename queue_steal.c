@@ -0,0 +1,190 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_steal.h"
+
+/* Elements the array of a new deque holds */
+#define WSD_MIN_SIZE 64
+
+/* Circular array of elements, with the smaller one it replaced */
+struct ws_array {
+    long mask;
+    struct ws_array *prev;
+    _Atomic(element_t *) slots[];
+};
+
+/*
+ * Elements are at slots[i & mask] for top <= i < bottom. Indices only grow,
+ * and are signed so that bottom - 1 may go below top.
+ */
+struct ws_deque {
+    /* Head, where thieves take elements */
+    union {
+        atomic_long top;
+        char top_line[CACHE_LINE];
+    };
+    /* Tail, only written by the owner */
+    union {
+        struct {
+            atomic_long bottom;
+            _Atomic(struct ws_array *) array;
+        };
+        char bottom_line[CACHE_LINE];
+    };
+};
+
+/*
+ * Allocate circular array of size elements, a power of 2.
+ * Return NULL if could not allocate space.
+ */
+static struct ws_array *array_new(long size);
+
+/*
+ * Replace full array a of deque d, holding the elements from top to bottom,
+ * by one twice as large.
+ * Return the new array, or NULL if could not allocate space.
+ */
+static struct ws_array *grow(ws_deque_t *d,
+                             struct ws_array *a,
+                             long top,
+                             long bottom);
+
+ws_deque_t *wsd_new(void)
+{
+    ws_deque_t *const d = malloc(sizeof(ws_deque_t));
+    struct ws_array *a;
+    if (!d)
+        return NULL;
+    a = array_new(WSD_MIN_SIZE);
+    if (!a) {
+        free(d);
+        return NULL;
+    }
+    a->prev = NULL;
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    atomic_init(&d->array, a);
+    q_set_threaded(true);
+    return d;
+}
+
+void wsd_free(ws_deque_t *d)
+{
+    struct ws_array *a, *prev;
+    if (!d)
+        return;
+    a = atomic_load(&d->array);
+    for (long i = atomic_load(&d->top); i < atomic_load(&d->bottom); i++)
+        element_free(atomic_load(&a->slots[i & a->mask]));
+    for (; a; a = prev) {
+        prev = a->prev;
+        free(a);
+    }
+    free(d);
+    element_trim();
+    q_set_threaded(false);
+}
+
+bool wsd_push(ws_deque_t *d, element_t *e)
+{
+    const long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    const long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    struct ws_array *a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    if (b - t > a->mask) {
+        a = grow(d, a, t, b);
+        if (!a)
+            return false;
+    }
+    atomic_store_explicit(&a->slots[b & a->mask], e, memory_order_relaxed);
+    // Thieves that see the new bottom see the element as well
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+element_t *wsd_pop(ws_deque_t *d)
+{
+    const long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    struct ws_array *const a =
+        atomic_load_explicit(&d->array, memory_order_relaxed);
+    element_t *e = NULL;
+    long t;
+    // Claim the last element before looking at top, so that a thief reading
+    // top after this either sees the claim or is seen here
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t <= b) {
+        e = atomic_load_explicit(&a->slots[b & a->mask], memory_order_relaxed);
+        if (t == b) {
+            // Only one element is left, which thieves may be after as well
+            if (!atomic_compare_exchange_strong_explicit(
+                    &d->top, &t, t + 1, memory_order_seq_cst,
+                    memory_order_relaxed))
+                e = NULL;
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return e;
+}
+
+element_t *wsd_steal(ws_deque_t *d)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    long b;
+    struct ws_array *a;
+    element_t *e;
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+        return NULL;
+    a = atomic_load_explicit(&d->array, memory_order_acquire);
+    e = atomic_load_explicit(&a->slots[t & a->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return NULL;
+    return e;
+}
+
+/*
+ * Allocate circular array of size elements, a power of 2.
+ * Return NULL if could not allocate space.
+ */
+static struct ws_array *array_new(long size)
+{
+    struct ws_array *const a =
+        malloc(sizeof(struct ws_array) + size * sizeof(element_t *));
+    if (a)
+        a->mask = size - 1;
+    return a;
+}
+
+/*
+ * Replace full array a of deque d, holding the elements from top to bottom,
+ * by one twice as large.
+ * Return the new array, or NULL if could not allocate space.
+ */
+static struct ws_array *grow(ws_deque_t *d,
+                             struct ws_array *a,
+                             long top,
+                             long bottom)
+{
+    struct ws_array *const bigger = array_new(2 * (a->mask + 1));
+    if (!bigger)
+        return NULL;
+    // Thieves may still be reading the old array, so it goes on the list
+    bigger->prev = a;
+    for (long i = top; i < bottom; i++) {
+        element_t *const e =
+            atomic_load_explicit(&a->slots[i & a->mask], memory_order_relaxed);
+        atomic_store_explicit(&bigger->slots[i & bigger->mask], e,
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&d->array, bigger, memory_order_release);
+    return bigger;
+}
@@ -0,0 +1,54 @@
+#ifndef LAB0_QUEUE_STEAL_H
+#define LAB0_QUEUE_STEAL_H
+
+/*
+ * Work-stealing deque of elements, after D. Chase and Y. Lev, "Dynamic
+ * Circular Work-Stealing Deque", SPAA 2005, with the C11 memory orderings of
+ * N. M. Lê, A. Pop, A. Cohen and F. Zappa Nardelli, "Correct and Efficient
+ * Work-Stealing for Weak Memory Models", PPoPP 2013.
+ *
+ * One thread owns the deque, and pushes and pops elements at its tail without
+ * locks or, unless a single element is left, atomic read-modify-writes. Any
+ * other thread may steal the element at its head with a compare-and-swap.
+ * The circular array the elements are in doubles when full. Arrays outgrown
+ * are kept until the deque is freed, as thieves may still be reading them.
+ */
+
+#include "queue.h"
+
+typedef struct ws_deque ws_deque_t;
+
+/*
+ * Create empty deque.
+ * Return NULL if could not allocate space.
+ */
+ws_deque_t *wsd_new(void);
+
+/*
+ * Free deque and the elements left in it. No other thread may be using it.
+ * No effect if d is NULL.
+ */
+void wsd_free(ws_deque_t *d);
+
+/*
+ * Insert element e, which the deque takes over, at its tail. Only for the
+ * owner thread.
+ * Return false, leaving e to the caller, if could not allocate space.
+ */
+bool wsd_push(ws_deque_t *d, element_t *e);
+
+/*
+ * Remove element from the tail of deque, the one pushed last, handing it over
+ * to the caller. Only for the owner thread.
+ * Return NULL if deque is empty.
+ */
+element_t *wsd_pop(ws_deque_t *d);
+
+/*
+ * Remove element from the head of deque, the one pushed first, handing it
+ * over to the caller. For any thread but the owner.
+ * Return NULL if deque is empty, or another thread took that element first.
+ */
+element_t *wsd_steal(ws_deque_t *d);
+
+#endif /* LAB0_QUEUE_STEAL_H */
@@ -0,0 +1,181 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+#include "queue_twolock.h"
+
+/*
+ * `next` of the last node is NULL. It is written by producers and may be read
+ * at the same time by a consumer, so it is accessed atomically.
+ */
+#define load_next(node) __atomic_load_n(&(node)->next, __ATOMIC_ACQUIRE)
+#define store_next(node, n) __atomic_store_n(&(node)->next, n, __ATOMIC_RELEASE)
+
+struct tl_node {
+    struct tl_node *next;
+    element_t *e; /* Already handed out if this is the dummy */
+};
+
+struct tl_queue {
+    /* Consumer side: the dummy node, whose successor holds the head element */
+    union {
+        struct {
+            pthread_mutex_t head_lock;
+            struct tl_node *head;
+        };
+        char head_lines[2 * CACHE_LINE];
+    };
+    /* Producer side: the last node, or the dummy if queue is empty */
+    union {
+        struct {
+            pthread_mutex_t tail_lock;
+            struct tl_node *tail;
+            struct tl_node *spare; /* Free nodes for insertions */
+        };
+        char tail_lines[2 * CACHE_LINE];
+    };
+    /* Nodes freed by removals, which insertions only ever take all at once */
+    union {
+        struct tl_node *recycled;
+        char recycled_line[CACHE_LINE];
+    };
+};
+
+/*
+ * Take a free node for an insertion, with the tail lock of queue q held, from
+ * its spare nodes, or else the nodes recycled by removals, or else malloc().
+ * Return NULL if could not allocate space.
+ */
+static struct tl_node *node_get(tl_queue_t *q);
+
+/*
+ * Free the nodes of chain n, linked through `next`.
+ */
+static void free_nodes(struct tl_node *n);
+
+tl_queue_t *tlq_new(void)
+{
+    tl_queue_t *const q = malloc(sizeof(tl_queue_t));
+    if (!q)
+        return NULL;
+    q->head = malloc(sizeof(struct tl_node));
+    if (!q->head) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->head_lock, NULL);
+    pthread_mutex_init(&q->tail_lock, NULL);
+    q->head->next = NULL;
+    q->head->e = NULL;
+    q->tail = q->head;
+    q->spare = q->recycled = NULL;
+    q_set_threaded(true);
+    return q;
+}
+
+void tlq_free(tl_queue_t *q)
+{
+    if (!q)
+        return;
+    // Only the dummy node at head holds no element
+    for (struct tl_node *n = q->head->next; n; n = n->next)
+        element_free(n->e);
+    free_nodes(q->head);
+    free_nodes(q->spare);
+    free_nodes(q->recycled);
+    pthread_mutex_destroy(&q->head_lock);
+    pthread_mutex_destroy(&q->tail_lock);
+    free(q);
+    element_trim();
+    q_set_threaded(false);
+}
+
+bool tlq_insert_tail(tl_queue_t *q, char *s)
+{
+    element_t *const e = element_new(s);
+    if (!e)
+        return false;
+    if (!tlq_enqueue(q, e)) {
+        element_free(e);
+        return false;
+    }
+    return true;
+}
+
+element_t *tlq_remove_head(tl_queue_t *q, char *sp, size_t bufsize)
+{
+    element_t *const e = tlq_dequeue(q);
+    if (e)
+        element_copy_string(e, sp, bufsize);
+    return e;
+}
+
+bool tlq_enqueue(tl_queue_t *q, element_t *e)
+{
+    struct tl_node *n;
+    pthread_mutex_lock(&q->tail_lock);
+    n = node_get(q);
+    if (!n) {
+        pthread_mutex_unlock(&q->tail_lock);
+        return false;
+    }
+    n->next = NULL;
+    n->e = e;
+    store_next(q->tail, n);
+    q->tail = n;
+    pthread_mutex_unlock(&q->tail_lock);
+    return true;
+}
+
+element_t *tlq_dequeue(tl_queue_t *q)
+{
+    struct tl_node *dummy, *first;
+    element_t *e;
+    pthread_mutex_lock(&q->head_lock);
+    dummy = q->head;
+    first = load_next(dummy);
+    if (!first) {
+        pthread_mutex_unlock(&q->head_lock);
+        return NULL;
+    }
+    // The first node becomes the dummy, and tail never points behind it
+    e = first->e;
+    q->head = first;
+    pthread_mutex_unlock(&q->head_lock);
+    // No other thread reaches the old dummy any more
+    dummy->next = __atomic_load_n(&q->recycled, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&q->recycled, &dummy->next, dummy,
+                                        true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+        ;
+    return e;
+}
+
+/*
+ * Take a free node for an insertion, with the tail lock of queue q held, from
+ * its spare nodes, or else the nodes recycled by removals, or else malloc().
+ * Return NULL if could not allocate space.
+ */
+static struct tl_node *node_get(tl_queue_t *q)
+{
+    struct tl_node *n = q->spare;
+    if (!n)
+        n = __atomic_exchange_n(&q->recycled, NULL, __ATOMIC_ACQUIRE);
+    if (!n)
+        return malloc(sizeof(struct tl_node));
+    q->spare = n->next;
+    return n;
+}
+
+/*
+ * Free the nodes of chain n, linked through `next`.
+ */
+static void free_nodes(struct tl_node *n)
+{
+    struct tl_node *next;
+    for (; n; n = next) {
+        next = n->next;
+        free(n);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef LAB0_QUEUE_TWOLOCK_H
+#define LAB0_QUEUE_TWOLOCK_H
+
+/*
+ * Concurrent queue of elements with one lock for inserting at tail and
+ * another for removing from head, after the two-lock queue of M. M. Michael
+ * and M. L. Scott, "Simple, Fast, and Practical Non-Blocking and Blocking
+ * Concurrent Queue Algorithms", PODC 1996.
+ *
+ * The elements are linked through nodes of the queue's own, the one at head
+ * being a dummy. A removal takes the element of the node after the dummy,
+ * which becomes the new dummy, so that it only ever needs the head lock, and
+ * an insertion only the tail lock. Nodes taken out are kept for later
+ * insertions, which only allocate while there are not enough of them yet.
+ */
+
+#include "queue.h"
+
+typedef struct tl_queue tl_queue_t;
+
+/*
+ * Create empty queue.
+ * Return NULL if could not allocate space.
+ */
+tl_queue_t *tlq_new(void);
+
+/*
+ * Free queue and the elements left in it. No other thread may be using it.
+ * No effect if q is NULL.
+ */
+void tlq_free(tl_queue_t *q);
+
+/*
+ * Attempt to insert element at tail of queue, as q_insert_tail().
+ * Return true if successful.
+ * Return false if could not allocate space.
+ */
+bool tlq_insert_tail(tl_queue_t *q, char *s);
+
+/*
+ * Attempt to remove element from head of queue, as q_remove_head().
+ * Return NULL if queue is empty.
+ */
+element_t *tlq_remove_head(tl_queue_t *q, char *sp, size_t bufsize);
+
+/*
+ * Insert element e, which the queue takes over, at tail of queue.
+ * Return false, leaving e to the caller, if could not allocate space.
+ */
+bool tlq_enqueue(tl_queue_t *q, element_t *e);
+
+/*
+ * Remove element from head of queue, handing it over to the caller.
+ * Return NULL if queue is empty.
+ */
+element_t *tlq_dequeue(tl_queue_t *q);
+
+#endif /* LAB0_QUEUE_TWOLOCK_H */
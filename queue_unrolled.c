@@ -0,0 +1,425 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "queue_backend.h"
+
+/*
+ * Unrolled list backend.
+ *
+ * Element pointers are stored in blocks of BLOCK_SIZE slots, and the blocks
+ * are linked into the list head of the queue. Blocks on the head side fill up
+ * from their end and blocks on the tail side from their beginning, so pushing
+ * and popping at either end touches only the outermost block. Walking the
+ * queue reads a block of pointers at a time instead of chasing one link per
+ * element.
+ *
+ * Only the sole block of an empty queue may be empty. It is kept, centred,
+ * instead of freed, so that inserting into an empty queue needs no allocation.
+ */
+
+/* Number of element slots per block */
+#define BLOCK_SIZE 64
+
+/* Block of element pointers. Slots first, ..., last - 1 are in use */
+typedef struct {
+    struct list_head list;
+    int first, last;
+    element_t *slots[BLOCK_SIZE];
+} block_t;
+
+/* Position of a slot in use */
+typedef struct {
+    block_t *b;
+    int i;
+} cursor_t;
+
+#define first_block(h) list_first_entry(h, block_t, list)
+#define last_block(h) list_last_entry(h, block_t, list)
+
+/*
+ * Create an empty block whose slots start at `pos`, and link it at head of
+ * the queue if `at_head` is true, at tail otherwise.
+ * Return NULL if could not allocate space.
+ */
+static block_t *block_new(struct list_head *head, bool at_head, int pos);
+
+/*
+ * Free block b which has just become empty, unless it is the only block of
+ * the queue, which is centred again instead.
+ */
+static void block_drop(struct list_head *head, block_t *b);
+
+/*
+ * Drop the slots from cursor c on, where c is past the last element kept, or
+ * has a NULL block if all elements are kept.
+ */
+static void cut_at(struct list_head *head, cursor_t *c);
+
+/*
+ * Point cursor c at the first element of a non-empty queue.
+ */
+static void cursor_init(struct list_head *head, cursor_t *c);
+
+/*
+ * Move cursor c to the next element, setting c->b to NULL past the tail.
+ */
+static void cursor_next(struct list_head *head, cursor_t *c);
+
+static bool unrolled_init(struct list_head *head)
+{
+    return block_new(head, true, BLOCK_SIZE / 2);
+}
+
+static void unrolled_free(struct list_head *head)
+{
+    block_t *b, *tmp;
+    list_for_each_entry_safe (b, tmp, head, list) {
+        for (int i = b->first; i < b->last; i++)
+            element_free(b->slots[i]);
+        free(b);
+    }
+}
+
+static bool unrolled_insert_head(struct list_head *head, element_t *e)
+{
+    block_t *b = first_block(head);
+    if (b->first == 0) {
+        b = block_new(head, true, BLOCK_SIZE);
+        if (!b)
+            return false;
+    }
+    b->slots[--b->first] = e;
+    return true;
+}
+
+static bool unrolled_insert_tail(struct list_head *head, element_t *e)
+{
+    block_t *b = last_block(head);
+    if (b->last == BLOCK_SIZE) {
+        b = block_new(head, false, 0);
+        if (!b)
+            return false;
+    }
+    b->slots[b->last++] = e;
+    return true;
+}
+
+static element_t *unrolled_remove_head(struct list_head *head)
+{
+    block_t *const b = first_block(head);
+    element_t *const e = b->slots[b->first++];
+    if (b->first == b->last)
+        block_drop(head, b);
+    return e;
+}
+
+static element_t *unrolled_remove_tail(struct list_head *head)
+{
+    block_t *const b = last_block(head);
+    element_t *const e = b->slots[--b->last];
+    if (b->first == b->last)
+        block_drop(head, b);
+    return e;
+}
+
+static element_t *unrolled_remove_mid(struct list_head *head)
+{
+    int idx = queue_of(head)->size / 2;
+    block_t *b;
+    element_t *e;
+    list_for_each_entry (b, head, list) {
+        if (idx < b->last - b->first)
+            break;
+        idx -= b->last - b->first;
+    }
+    idx += b->first;
+    e = b->slots[idx];
+    // Close the gap from whichever side of the block has fewer slots to move
+    if (idx - b->first < b->last - idx) {
+        memmove(&b->slots[b->first + 1], &b->slots[b->first],
+                (idx - b->first) * sizeof(element_t *));
+        b->first++;
+    } else {
+        memmove(&b->slots[idx], &b->slots[idx + 1],
+                (b->last - idx - 1) * sizeof(element_t *));
+        b->last--;
+    }
+    if (b->first == b->last)
+        block_drop(head, b);
+    return e;
+}
+
+static element_t *unrolled_peek_head(struct list_head *head)
+{
+    block_t *const b = first_block(head);
+    return b->slots[b->first];
+}
+
+static element_t *unrolled_peek_tail(struct list_head *head)
+{
+    block_t *const b = last_block(head);
+    return b->slots[b->last - 1];
+}
+
+static int unrolled_for_each(struct list_head *head,
+                             bool reversed,
+                             q_visit_t visit,
+                             void *priv)
+{
+    block_t *b;
+    int cnt = 0;
+    if (reversed) {
+        for (struct list_head *node = head->prev; node != head;
+             node = node->prev) {
+            b = list_entry(node, block_t, list);
+            for (int i = b->last - 1; i >= b->first; i--) {
+                cnt++;
+                if (!visit(b->slots[i], priv))
+                    return cnt;
+            }
+        }
+        return cnt;
+    }
+    list_for_each_entry (b, head, list) {
+        for (int i = b->first; i < b->last; i++) {
+            cnt++;
+            if (!visit(b->slots[i], priv))
+                return cnt;
+        }
+    }
+    return cnt;
+}
+
+static int unrolled_delete_dup(struct list_head *head)
+{
+    cursor_t r, w;
+    element_t *prev;
+    bool is_prev_dup = false;
+    int cnt = 0;
+    if (!queue_of(head)->size)
+        return 0;
+    cursor_init(head, &r);
+    w = r;
+    prev = r.b->slots[r.i];
+    // Each element is kept or released once its successor has been seen, and
+    // kept ones are packed towards the head, in the slots already read
+    for (cursor_next(head, &r); r.b; cursor_next(head, &r)) {
+        element_t *const e = r.b->slots[r.i];
+        bool is_dup = element_cmp(prev, e) == 0;
+        if (is_prev_dup || is_dup) {
+            element_free(prev);
+            cnt++;
+        } else {
+            w.b->slots[w.i] = prev;
+            cursor_next(head, &w);
+        }
+        prev = e;
+        is_prev_dup = is_dup;
+    }
+    if (is_prev_dup) {
+        element_free(prev);
+        cnt++;
+    } else {
+        w.b->slots[w.i] = prev;
+        cursor_next(head, &w);
+    }
+    cut_at(head, &w);
+    return cnt;
+}
+
+static int unrolled_filter(struct list_head *head,
+                           q_visit_t keep,
+                           void *priv,
+                           struct list_head *out)
+{
+    cursor_t r, w;
+    int cnt = 0;
+    if (!queue_of(head)->size)
+        return 0;
+    cursor_init(head, &r);
+    // Kept elements are packed towards the head, in the slots already read
+    for (w = r; r.b; cursor_next(head, &r)) {
+        element_t *const e = r.b->slots[r.i];
+        if (keep(e, priv)) {
+            w.b->slots[w.i] = e;
+            cursor_next(head, &w);
+        } else {
+            list_add_tail(&e->list, out);
+            cnt++;
+        }
+    }
+    cut_at(head, &w);
+    return cnt;
+}
+
+static void unrolled_swap(struct list_head *head)
+{
+    cursor_t i, j;
+    if (!queue_of(head)->size)
+        return;
+    for (cursor_init(head, &i); i.b; cursor_next(head, &i)) {
+        element_t *tmp;
+        j = i;
+        cursor_next(head, &j);
+        if (!j.b)
+            return;
+        tmp = i.b->slots[i.i];
+        i.b->slots[i.i] = j.b->slots[j.i];
+        j.b->slots[j.i] = tmp;
+        i = j;
+    }
+}
+
+static void unrolled_reverse(struct list_head *head)
+{
+    struct list_head *node, *safe;
+    list_for_each_safe (node, safe, head) {
+        block_t *const b = list_entry(node, block_t, list);
+        int first = b->first;
+        // Mirror the whole block, so that its head side becomes the tail side
+        for (int i = 0, j = BLOCK_SIZE - 1; i < j; i++, j--) {
+            element_t *tmp = b->slots[i];
+            b->slots[i] = b->slots[j];
+            b->slots[j] = tmp;
+        }
+        b->first = BLOCK_SIZE - b->last;
+        b->last = BLOCK_SIZE - first;
+        list_move(node, head);
+    }
+}
+
+static void unrolled_sort(struct list_head *head)
+{
+    // Pending runs, the one at level k holding about 2^k blocks of elements
+    struct list_head *runs[32] = {NULL};
+    struct list_head *run = NULL;
+    block_t *b;
+    cursor_t c;
+    if (queue_of(head)->size <= 1)
+        return;
+    list_for_each_entry (b, head, list) {
+        int lvl;
+        // Insertion sort the block, then chain its elements into a run
+        // through their list links, which this backend does not use otherwise
+        for (int i = b->first + 1; i < b->last; i++) {
+            element_t *const e = b->slots[i];
+            int j = i;
+            for (; j > b->first && element_cmp(b->slots[j - 1], e) > 0; j--)
+                b->slots[j] = b->slots[j - 1];
+            b->slots[j] = e;
+        }
+        run = NULL;
+        for (int i = b->last - 1; i >= b->first; i--) {
+            b->slots[i]->list.next = run;
+            run = &b->slots[i]->list;
+        }
+        for (lvl = 0; runs[lvl]; lvl++) {
+            run = merge_chains(runs[lvl], run);
+            runs[lvl] = NULL;
+        }
+        runs[lvl] = run;
+    }
+    run = NULL;
+    for (int lvl = 0; lvl < 32; lvl++) {
+        if (runs[lvl])
+            run = run ? merge_chains(runs[lvl], run) : runs[lvl];
+    }
+    // Write the sorted elements back into the same slots
+    for (cursor_init(head, &c); c.b; cursor_next(head, &c)) {
+        c.b->slots[c.i] = list_entry(run, element_t, list);
+        run = run->next;
+    }
+}
+
+const struct queue_ops unrolled_ops = {
+    .init = unrolled_init,
+    .free = unrolled_free,
+    .insert_head = unrolled_insert_head,
+    .insert_tail = unrolled_insert_tail,
+    .remove_head = unrolled_remove_head,
+    .remove_tail = unrolled_remove_tail,
+    .remove_mid = unrolled_remove_mid,
+    .peek_head = unrolled_peek_head,
+    .peek_tail = unrolled_peek_tail,
+    .for_each = unrolled_for_each,
+    .delete_dup = unrolled_delete_dup,
+    .filter = unrolled_filter,
+    .swap = unrolled_swap,
+    .reverse = unrolled_reverse,
+    .sort = unrolled_sort,
+};
+
+/*
+ * Create an empty block whose slots start at `pos`, and link it at head of
+ * the queue if `at_head` is true, at tail otherwise.
+ * Return NULL if could not allocate space.
+ */
+static block_t *block_new(struct list_head *head, bool at_head, int pos)
+{
+    block_t *const b = malloc(sizeof(block_t));
+    if (!b)
+        return NULL;
+    b->first = b->last = pos;
+    if (at_head)
+        list_add(&b->list, head);
+    else
+        list_add_tail(&b->list, head);
+    return b;
+}
+
+/*
+ * Free block b which has just become empty, unless it is the only block of
+ * the queue, which is centred again instead.
+ */
+static void block_drop(struct list_head *head, block_t *b)
+{
+    if (list_is_singular(head)) {
+        b->first = b->last = BLOCK_SIZE / 2;
+        return;
+    }
+    list_del(&b->list);
+    free(b);
+}
+
+/*
+ * Drop the slots from cursor c on, where c is past the last element kept, or
+ * has a NULL block if all elements are kept.
+ */
+static void cut_at(struct list_head *head, cursor_t *c)
+{
+    if (!c->b)
+        return;
+    while (c->b->list.next != head) {
+        block_t *const b = list_entry(c->b->list.next, block_t, list);
+        list_del(&b->list);
+        free(b);
+    }
+    c->b->last = c->i;
+    if (c->b->first == c->b->last)
+        block_drop(head, c->b);
+}
+
+/*
+ * Point cursor c at the first element of a non-empty queue.
+ */
+static void cursor_init(struct list_head *head, cursor_t *c)
+{
+    c->b = first_block(head);
+    c->i = c->b->first;
+}
+
+/*
+ * Move cursor c to the next element, setting c->b to NULL past the tail.
+ */
+static void cursor_next(struct list_head *head, cursor_t *c)
+{
+    if (++c->i < c->b->last)
+        return;
+    if (c->b->list.next == head) {
+        c->b = NULL;
+        return;
+    }
+    c->b = list_entry(c->b->list.next, block_t, list);
+    c->i = c->b->first;
+}
@@ -1,7 +1,9 @@
-# Test if time complexity of q_insert_tail, q_insert_head, q_remove_tail, and q_remove_head is constant
+# Test if time complexity of q_insert_tail, q_insert_head, q_remove_tail, q_remove_head, q_size, and q_delete_mid is constant
 option simulation 1
 it
 ih
 rh
 rt
+size
+dm
 option simulation 0
@@ -0,0 +1,54 @@
+option echo 0
+option verbose 1
+
+# Run the performance traces against each backend.
+# Each `time` reports the time since the previous one, and each `mem` the heap
+# in use and its peak since the previous `mem`.
+
+# list backend
+option backend 0
+time
+source traces/trace-14-perf.cmd
+time
+mem
+free
+mem
+source traces/trace-15-perf.cmd
+time
+mem
+source traces/trace-16-perf.cmd
+time
+mem
+free
+
+# unrolled backend
+option backend 1
+time
+source traces/trace-14-perf.cmd
+time
+mem
+free
+mem
+source traces/trace-15-perf.cmd
+time
+mem
+source traces/trace-16-perf.cmd
+time
+mem
+free
+
+# ring backend
+option backend 2
+time
+source traces/trace-14-perf.cmd
+time
+mem
+free
+mem
+source traces/trace-15-perf.cmd
+time
+mem
+source traces/trace-16-perf.cmd
+time
+mem
+free
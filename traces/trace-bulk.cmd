@@ -0,0 +1,37 @@
+option echo 0
+option verbose 1
+
+# one insertion per call
+option bulk 0
+new
+time ih RAND 1000000
+time it RAND 1000000
+size
+free
+new
+time ih dolphin 1000000
+time it gerbil 1000000
+size
+free
+
+# bulk insertion
+option bulk 256
+new
+time ih RAND 1000000
+time it RAND 1000000
+size
+free
+new
+time ih dolphin 1000000
+time it gerbil 1000000
+size
+free
+
+# bulk removal
+new
+ih dolphin 1000000
+it gerbil 1000000
+time rhn 1500000
+time rhn 1000000
+size
+free
@@ -0,0 +1,43 @@
+option echo 0
+option verbose 1
+
+# delete duplicates by sorting first
+new
+it RAND 500000
+ih gerbil 100000
+it gerbil 100000
+time
+sort
+dedup
+time
+free
+
+# delete duplicates with a hash table, without sorting
+new
+it RAND 500000
+ih gerbil 100000
+it gerbil 100000
+time
+dedup hash
+time
+free
+
+# hash table on the other backends
+option backend 1
+new
+it RAND 500000
+ih gerbil 100000
+it gerbil 100000
+time
+dedup hash
+time
+free
+option backend 2
+new
+it RAND 500000
+ih gerbil 100000
+it gerbil 100000
+time
+dedup hash
+time
+free
@@ -0,0 +1,25 @@
+option echo 0
+option verbose 1
+
+# long strings, each element holding its own copy
+new
+ih dolphin_of_the_northern_seas 500000
+it gerbil_of_the_southern_plains 500000
+time
+mem
+sort
+time
+free
+
+# long strings shared through the interning table
+option intern 1
+new
+ih dolphin_of_the_northern_seas 500000
+it gerbil_of_the_southern_plains 500000
+time
+mem
+sort
+dedup
+time
+free
+option intern 0
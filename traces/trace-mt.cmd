@@ -0,0 +1,69 @@
+option echo 0
+option verbose 1
+
+# many threads contending, checking each string is removed once and in order
+mt mutex 16 16 10000
+mt lockfree 16 16 10000
+mt lockfree 48 16 2000
+mt lockfree 4 60 20000
+mt twolock 16 16 10000
+mt twolock 48 16 2000
+mt twolock 4 60 20000
+mt blocking 16 16 10000
+mt blocking 48 16 2000
+mt blocking 4 60 20000
+mt combining 16 16 10000
+mt combining 48 16 2000
+mt combining 4 60 20000
+mt sharded 16 16 10000
+mt sharded 48 16 2000
+mt sharded 4 60 20000
+mt sharded-strict 16 16 10000
+mt sharded-strict 48 16 2000
+mt sharded-strict 4 60 20000
+
+# throughput with few threads
+mt mutex 2 2 500000
+mt lockfree 2 2 500000
+mt twolock 2 2 500000
+mt mutex 1 1 1000000
+mt lockfree 1 1 1000000
+mt twolock 1 1 1000000
+mt spsc 1 1 1000000
+mt spsc32 1 1 1000000
+mt blocking 2 2 500000
+mt blocking 1 1 1000000
+
+# scaling from 1 to 32 threads of each kind, of a single queue behind one
+# lock against the sharded queue, relaxed and strictly FIFO
+mt mutex 1 1 200000
+mt sharded 1 1 200000
+mt sharded-strict 1 1 200000
+mt mutex 4 4 50000
+mt sharded 4 4 50000
+mt sharded-strict 4 4 50000
+mt mutex 16 16 12500
+mt sharded 16 16 12500
+mt sharded-strict 16 16 12500
+mt mutex 32 32 6250
+mt sharded 32 32 6250
+mt sharded-strict 32 32 6250
+
+# contention on the sequential queue, one lock per operation against flat
+# combining
+mt mutex 8 8 25000
+mt combining 8 8 25000
+mt mutex 32 32 6250
+mt combining 32 32 6250
+mt mutex 48 16 4000
+mt combining 48 16 4000
+
+# wakeup latency of consumers blocked on the queue, and its eventfd watched
+# by the command loop
+wake 1000
+feed 10 1
+
+# load balance of workers running a skewed task list, without and with
+# work stealing
+option workers 8
+sched 20000
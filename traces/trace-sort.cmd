@@ -25,6 +25,10 @@ it RAND 262144
 time sort
 # sort sorted list
 time sort
+# sort reverse sorted list
+reverse
+time sort
+cmp
 
 # kernel-version sort
 option sort 1
@@ -45,3 +49,67 @@ it RAND 262144
 time sort
 # sort sorted list
 time sort
+cmp
+
+# radix sort
+option sort 2
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+# sort sorted list
+time sort
+cmp
+
+# pointer array sort
+option sort 3
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+# sort sorted list
+time sort
+cmp
+
+# parallel sort
+option sort 4
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+new
+it RAND 262144
+time sort
+# sort sorted list
+time sort
+cmp